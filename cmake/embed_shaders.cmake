@@ -0,0 +1,36 @@
+# Run as a build step (cmake -P): writes OUTPUT, a header with every file under
+# SHADER_DIR as a constexpr string, named by its path relative to SHADER_DIR.
+# The header is only replaced when its contents change, so editing a shader
+# recompiles shader_sources.cpp and nothing else.
+file(GLOB_RECURSE SHADER_FILES RELATIVE ${SHADER_DIR} ${SHADER_DIR}/*)
+list(SORT SHADER_FILES)
+set(SOURCES "")
+set(ENTRIES "")
+set(INDEX 0)
+foreach(NAME ${SHADER_FILES})
+  file(READ ${SHADER_DIR}/${NAME} SOURCE)
+  string(APPEND SOURCES "static constexpr char EMBEDDED_SHADER_${INDEX}[] = R\"cals_shader(${SOURCE})cals_shader\";\n")
+  string(APPEND ENTRIES "  {fnv1a64(\"${NAME}\"), \"${NAME}\", EMBEDDED_SHADER_${INDEX}, sizeof(EMBEDDED_SHADER_${INDEX}) - 1},\n")
+  math(EXPR INDEX "${INDEX} + 1")
+endforeach()
+file(WRITE ${OUTPUT}.tmp
+"// generated by cmake/embed_shaders.cmake from src/shaders, do not edit
+#pragma once
+#include \"hash.h\"
+#include <cstddef>
+
+struct EmbeddedShader
+{
+  uint64_t nameHash;
+  const char *name;
+  const char *source;
+  size_t size;
+};
+
+${SOURCES}
+static constexpr EmbeddedShader EMBEDDED_SHADERS[] =
+{
+${ENTRIES}};
+")
+configure_file(${OUTPUT}.tmp ${OUTPUT} COPYONLY)
+file(REMOVE ${OUTPUT}.tmp)
@@ -2,97 +2,237 @@
 #define SHADER_H
 
 #include "../src/config.h"
+#include "../src/hash.h"
+#include "../src/program_build.h"
+#include "../src/gl_state.h"
+#include "../src/cpu_profiler.h"
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+//a uniform named by its hash; built from a literal in a constexpr variable the hash is computed at compile time:
+//  static constexpr UniformId MATERIALS("materials");
+struct UniformId
+{
+    uint64_t hash;
+    constexpr UniformId(const char* name) : hash(fnv1a64(name)) {}
+    UniformId(const std::string &name) : hash(fnv1a64(name.c_str())) {}
+};
+
+//one active uniform as reported by the driver after linking
+struct UniformInfo
+{
+    std::string name;
+    GLint location;
+    GLenum type;
+    GLint size;
+};
 
 class Shader
 {
     public:
         unsigned int ID;
+        //reads, compiles and links right away; build many at once through ProgramBatch instead
         Shader(const char* vertexPath, const char* fragmentPath)
         {
-            std::string vertexCode;
-            std::string fragmentCode;
-            std::ifstream vShaderFile;
-            std::ifstream fShaderFile;
-            vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-            fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-            try
-            {
-                vShaderFile.open(vertexPath);
-                fShaderFile.open(fragmentPath);
-                std::stringstream vShaderStream, fShaderStream;
-                vShaderStream << vShaderFile.rdbuf();
-                fShaderStream << fShaderFile.rdbuf();
-                vShaderFile.close();
-                fShaderFile.close();
-                vertexCode = vShaderStream.str();
-                fragmentCode = fShaderStream.str();
+            CPU_ZONE("Shader");
+            ProgramBatch batch;
+            batch.add(vertexPath, fragmentPath);
+            ID = batch.finish()[0];
+            reflectUniforms();
+        }
+        //takes a program that is already linked, e.g. from ProgramBatch::finish
+        explicit Shader(unsigned int program) : ID(program)
+        {
+            reflectUniforms();
+        }
 
-            }
-            catch(std::ifstream::failure e)
+        void use()
+        {
+            glState().useProgram(ID);
+        }
+        //-1 for names the program does not use, which glUniform* ignores
+        GLint location(UniformId name) const
+        {
+            auto found = locations.find(name.hash);
+            return found != locations.end() ? found->second : -1;
+        }
+        bool hasUniform(UniformId name) const
+        {
+            return locations.count(name.hash) != 0;
+        }
+        //every active uniform outside a uniform block
+        const std::vector<UniformInfo> &uniforms() const
+        {
+            return activeUniforms;
+        }
+
+        //points a uniform block at a binding point (see UniformBlockBuffer), kept across hot reloads
+        //with blockSize, false (and logs) if the driver's layout of the block has another size
+        bool bindBlock(const char* name, GLuint binding, size_t blockSize = 0)
+        {
+            auto bound = std::find_if(blockBindings.begin(), blockBindings.end(),
+                                      [&](const std::pair<std::string, GLuint> &block) { return block.first == name; });
+            if (bound == blockBindings.end())
             {
-                std::cout<< "ERROR::SHADER::READING_FILE_FAILED" << std::endl;
+                blockBindings.emplace_back(name, binding);
             }
-            const char* vShaderCode = vertexCode.c_str();
-            const char* fShaderCode = fragmentCode.c_str();
-            
-            unsigned int vertex, fragment;
-            int success;
-            char infoLog[512];
-            //vertex creation
-            vertex = glCreateShader(GL_VERTEX_SHADER);
-            //attach shader code to shader object && compile (has to be compiled at runtime)
-            glShaderSource(vertex,1,&vShaderCode,NULL);
-            glCompileShader(vertex);
-            //check for errors
-            glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
-            if (!success)
+            else
             {
-                glGetShaderInfoLog(vertex, 512, NULL, infoLog);
-                std::cout << "ERROR::SHADER::VERTEX_COMPILATION_FAILED\n" << infoLog << std::endl;
+                bound->second = binding;
             }
-            //fragment creation
-            fragment = glCreateShader(GL_FRAGMENT_SHADER);
-            glShaderSource(fragment, 1, &fShaderCode, NULL);
-            glCompileShader(fragment);
-            glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
-            if (!success)
+            return applyBlockBinding(name, binding, blockSize);
+        }
+
+        //a table lookup and the glUniform call, the driver never sees the name
+        void setBool(UniformId name, bool value) const
+        {
+            glUniform1i(location(name), (int)value);
+        }
+        void setInt(UniformId name, int value) const
+        {
+            glUniform1i(location(name), value);
+        }
+        void setFloat(UniformId name, float value) const
+        {
+            glUniform1f(location(name), value);
+        }
+        void setVec2(UniformId name, float x, float y) const
+        {
+            glUniform2f(location(name), x, y);
+        }
+        void setVec3(UniformId name, float x, float y, float z) const
+        {
+            glUniform3f(location(name), x, y, z);
+        }
+        void setVec4(UniformId name, float x, float y, float z, float w) const
+        {
+            glUniform4f(location(name), x, y, z, w);
+        }
+        void setMat4(UniformId name, const float* value) const
+        {
+            glUniformMatrix4fv(location(name), 1, GL_FALSE, value);
+        }
+
+        //swaps in a rebuilt program (hot reload): values of uniforms both programs share are carried
+        //over, the new program is left bound if the old one was, and the old one is deleted
+        void replaceProgram(unsigned int program)
+        {
+            Shader next(program);
+            GLuint current = glState().program();
+            glState().useProgram(program);
+            for (const UniformInfo &info : activeUniforms)
             {
-                glGetShaderInfoLog(fragment, 512, NULL, infoLog);
-                std::cout << "ERROR::SHADER::FRAGMENT_COMPILATION_FAILED\n" << infoLog << std::endl;
+                //only where the declaration is unchanged, an edited type starts from its default
+                for (const UniformInfo &other : next.activeUniforms)
+                {
+                    if (other.name == info.name && other.type == info.type)
+                    {
+                        copyUniform(info, other.location);
+                    }
+                }
             }
-            //shader program creation
-            ID = glCreateProgram();
-            glAttachShader(ID, vertex);
-            glAttachShader(ID, fragment);
-            glLinkProgram(ID);
-            glGetProgramiv(fragment, GL_LINK_STATUS, &success);
-            if (!success)
+            glState().useProgram(current == ID ? program : current);
+            glDeleteProgram(ID);
+            ID = program;
+            activeUniforms = std::move(next.activeUniforms);
+            locations = std::move(next.locations);
+            for (const auto &bound : blockBindings)
             {
-                glGetShaderInfoLog(ID, 512, NULL, infoLog);
-                std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+                applyBlockBinding(bound.first.c_str(), bound.second, 0);
             }
-            //if successful, delete shaders
-            glDeleteShader(vertex);
-            glDeleteShader(fragment);
         }
 
-        void use()
-        {
-            glUseProgram(ID);
-        }
-        void setBool(const std::string &name, bool value) const
+    private:
+        std::vector<UniformInfo> activeUniforms;
+        std::unordered_map<uint64_t, GLint> locations;
+        std::vector<std::pair<std::string, GLuint>> blockBindings;
+
+        bool applyBlockBinding(const char* name, GLuint binding, size_t blockSize) const
         {
-            glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+            GLuint index = ID ? glGetUniformBlockIndex(ID, name) : GL_INVALID_INDEX;
+            if (index == GL_INVALID_INDEX)
+            {
+                return false;
+            }
+            glUniformBlockBinding(ID, index, binding);
+            GLint size = 0;
+            glGetActiveUniformBlockiv(ID, index, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+            if (blockSize && (size_t)size != blockSize)
+            {
+                std::cout << "ERROR::SHADER::UNIFORM_BLOCK_SIZE " << name << " is " << size << " bytes, expected " << blockSize << std::endl;
+                return false;
+            }
+            return true;
         }
-        void setInt(const std::string &name, int value) const
+
+        //reads one uniform (element 0 of an array) from this program into the bound one
+        void copyUniform(const UniformInfo &info, GLint to) const
         {
-            glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+            float floats[16];
+            GLint ints[4];
+            GLuint uints[4];
+            switch (info.type)
+            {
+                case GL_FLOAT: glGetUniformfv(ID, info.location, floats); glUniform1fv(to, 1, floats); break;
+                case GL_FLOAT_VEC2: glGetUniformfv(ID, info.location, floats); glUniform2fv(to, 1, floats); break;
+                case GL_FLOAT_VEC3: glGetUniformfv(ID, info.location, floats); glUniform3fv(to, 1, floats); break;
+                case GL_FLOAT_VEC4: glGetUniformfv(ID, info.location, floats); glUniform4fv(to, 1, floats); break;
+                case GL_FLOAT_MAT2: glGetUniformfv(ID, info.location, floats); glUniformMatrix2fv(to, 1, GL_FALSE, floats); break;
+                case GL_FLOAT_MAT3: glGetUniformfv(ID, info.location, floats); glUniformMatrix3fv(to, 1, GL_FALSE, floats); break;
+                case GL_FLOAT_MAT4: glGetUniformfv(ID, info.location, floats); glUniformMatrix4fv(to, 1, GL_FALSE, floats); break;
+                //bool vectors are set with the int calls, reading them back gives 0 or 1
+                case GL_INT_VEC2:
+                case GL_BOOL_VEC2: glGetUniformiv(ID, info.location, ints); glUniform2iv(to, 1, ints); break;
+                case GL_INT_VEC3:
+                case GL_BOOL_VEC3: glGetUniformiv(ID, info.location, ints); glUniform3iv(to, 1, ints); break;
+                case GL_INT_VEC4:
+                case GL_BOOL_VEC4: glGetUniformiv(ID, info.location, ints); glUniform4iv(to, 1, ints); break;
+                //the signed calls are a GL_INVALID_OPERATION on unsigned uniforms
+                case GL_UNSIGNED_INT: glGetUniformuiv(ID, info.location, uints); glUniform1uiv(to, 1, uints); break;
+                case GL_UNSIGNED_INT_VEC2: glGetUniformuiv(ID, info.location, uints); glUniform2uiv(to, 1, uints); break;
+                case GL_UNSIGNED_INT_VEC3: glGetUniformuiv(ID, info.location, uints); glUniform3uiv(to, 1, uints); break;
+                case GL_UNSIGNED_INT_VEC4: glGetUniformuiv(ID, info.location, uints); glUniform4uiv(to, 1, uints); break;
+                //int, bool and samplers are set with glUniform1i
+                default: glGetUniformiv(ID, info.location, ints); glUniform1iv(to, 1, ints); break;
+            }
         }
-        void setFloat(const std::string &name, float value) const
+
+        //asks the driver for every uniform once, right after linking
+        void reflectUniforms()
         {
-            glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+            //a failed build leaves no program to ask
+            if (!ID)
+            {
+                return;
+            }
+            GLint count = 0;
+            GLint maxLength = 0;
+            glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+            glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+            std::vector<char> buffer(std::max(maxLength, 1));
+            for (GLint i = 0; i < count; i++)
+            {
+                UniformInfo info;
+                GLsizei length = 0;
+                glGetActiveUniform(ID, (GLuint)i, (GLsizei)buffer.size(), &length, &info.size, &info.type, buffer.data());
+                info.name.assign(buffer.data(), length);
+                info.location = glGetUniformLocation(ID, info.name.c_str());
+                //block members have no location, they are set through their buffer
+                if (info.location < 0)
+                {
+                    continue;
+                }
+                locations[fnv1a64(info.name.c_str())] = info.location;
+                //arrays are reported as "name[0]", make plain "name" work as well
+                size_t bracket = info.name.find("[0]");
+                if (bracket != std::string::npos)
+                {
+                    locations[fnv1a64(info.name.substr(0, bracket).c_str())] = info.location;
+                }
+                activeUniforms.push_back(info);
+            }
         }
-
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,631 @@
+#include "bcn_encoder.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define BCN_USE_SSE2 1
+#endif
+
+//one 4x4 block split into channels so four pixels fit one SSE register
+struct Block
+{
+  float r[16], g[16], b[16], a[16];
+};
+
+//a palette entry, channels in rgba order
+struct Color
+{
+  float c[4];
+};
+
+size_t blockBytes(BlockFormat format)
+{
+  switch (format)
+  {
+    case BlockFormat::BC1: return 8;
+    case BlockFormat::BC3: return 16;
+    case BlockFormat::BC7: return 16;
+    default: return 0;
+  }
+}
+
+size_t compressedLevelSize(BlockFormat format, int width, int height)
+{
+  return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+}
+
+static void loadBlock(const unsigned char *pixels, int width, int height, int channels, int blockX, int blockY, Block &block)
+{
+  for (int i = 0; i < 16; i++)
+  {
+    //edge blocks repeat the last row/column so padding never drags the endpoints around
+    int x = std::min(blockX * 4 + (i & 3), width - 1);
+    int y = std::min(blockY * 4 + (i >> 2), height - 1);
+    const unsigned char *pixel = pixels + ((size_t)y * width + x) * channels;
+    //same expansion GL applies when sampling R8/RG8/RGB8 textures
+    block.r[i] = pixel[0];
+    block.g[i] = channels > 1 ? pixel[1] : 0.0f;
+    block.b[i] = channels > 2 ? pixel[2] : 0.0f;
+    block.a[i] = channels > 3 ? pixel[3] : 255.0f;
+  }
+}
+
+/*
+* Picks the closest palette entry for every pixel and returns the summed
+* squared error. Alpha only counts when useAlpha is set.
+*/
+static float findIndices(const Block &block, const Color *palette, int paletteSize, bool useAlpha, uint8_t indices[16])
+{
+  float alphaWeight = useAlpha ? 1.0f : 0.0f;
+#ifdef BCN_USE_SSE2
+  __m128 total = _mm_setzero_ps();
+  __m128 weight = _mm_set1_ps(alphaWeight);
+  for (int group = 0; group < 16; group += 4)
+  {
+    __m128 r = _mm_loadu_ps(block.r + group);
+    __m128 g = _mm_loadu_ps(block.g + group);
+    __m128 b = _mm_loadu_ps(block.b + group);
+    __m128 a = _mm_loadu_ps(block.a + group);
+    __m128 best = _mm_set1_ps(3.0e38f);
+    __m128i bestIndex = _mm_setzero_si128();
+    for (int p = 0; p < paletteSize; p++)
+    {
+      __m128 dr = _mm_sub_ps(r, _mm_set1_ps(palette[p].c[0]));
+      __m128 dg = _mm_sub_ps(g, _mm_set1_ps(palette[p].c[1]));
+      __m128 db = _mm_sub_ps(b, _mm_set1_ps(palette[p].c[2]));
+      __m128 da = _mm_sub_ps(a, _mm_set1_ps(palette[p].c[3]));
+      __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)),
+                                   _mm_add_ps(_mm_mul_ps(db, db), _mm_mul_ps(_mm_mul_ps(da, da), weight)));
+      __m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best));
+      best = _mm_min_ps(distance, best);
+      bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(p)), _mm_andnot_si128(closer, bestIndex));
+    }
+    total = _mm_add_ps(total, best);
+    alignas(16) int32_t lanes[4];
+    _mm_store_si128((__m128i*)lanes, bestIndex);
+    for (int i = 0; i < 4; i++)
+    {
+      indices[group + i] = (uint8_t)lanes[i];
+    }
+  }
+  alignas(16) float sums[4];
+  _mm_store_ps(sums, total);
+  return sums[0] + sums[1] + sums[2] + sums[3];
+#else
+  float total = 0.0f;
+  for (int i = 0; i < 16; i++)
+  {
+    float best = 3.0e38f;
+    for (int p = 0; p < paletteSize; p++)
+    {
+      float dr = block.r[i] - palette[p].c[0];
+      float dg = block.g[i] - palette[p].c[1];
+      float db = block.b[i] - palette[p].c[2];
+      float da = block.a[i] - palette[p].c[3];
+      float distance = dr * dr + dg * dg + db * db + da * da * alphaWeight;
+      if (distance < best)
+      {
+        best = distance;
+        indices[i] = (uint8_t)p;
+      }
+    }
+    total += best;
+  }
+  return total;
+#endif
+}
+
+static void pixelAt(const Block &block, int i, float out[4])
+{
+  out[0] = block.r[i];
+  out[1] = block.g[i];
+  out[2] = block.b[i];
+  out[3] = block.a[i];
+}
+
+/*
+* Initial endpoints for the first channelCount channels.
+* Fast takes the (slightly inset) bounding box diagonal, the others project
+* onto the principal axis of the colours found by power iteration.
+*/
+static void chooseEndpoints(const Block &block, int channelCount, EncodeQuality quality, float e0[4], float e1[4])
+{
+  float minimum[4] = {255, 255, 255, 255}, maximum[4] = {0, 0, 0, 0}, mean[4] = {0, 0, 0, 0};
+  for (int i = 0; i < 16; i++)
+  {
+    float pixel[4];
+    pixelAt(block, i, pixel);
+    for (int c = 0; c < 4; c++)
+    {
+      minimum[c] = std::min(minimum[c], pixel[c]);
+      maximum[c] = std::max(maximum[c], pixel[c]);
+      mean[c] += pixel[c] / 16.0f;
+    }
+  }
+  for (int c = channelCount; c < 4; c++)
+  {
+    minimum[c] = maximum[c] = mean[c];
+  }
+  if (quality == EncodeQuality::Fast)
+  {
+    for (int c = 0; c < 4; c++)
+    {
+      float inset = (maximum[c] - minimum[c]) / 16.0f;
+      e0[c] = maximum[c] - inset;
+      e1[c] = minimum[c] + inset;
+    }
+    return;
+  }
+
+  float covariance[4][4] = {};
+  for (int i = 0; i < 16; i++)
+  {
+    float pixel[4];
+    pixelAt(block, i, pixel);
+    for (int x = 0; x < channelCount; x++)
+    {
+      for (int y = 0; y < channelCount; y++)
+      {
+        covariance[x][y] += (pixel[x] - mean[x]) * (pixel[y] - mean[y]);
+      }
+    }
+  }
+  float axis[4] = {0, 0, 0, 0};
+  for (int c = 0; c < channelCount; c++)
+  {
+    axis[c] = maximum[c] - minimum[c];
+  }
+  for (int iteration = 0; iteration < 8; iteration++)
+  {
+    float next[4] = {0, 0, 0, 0};
+    float length = 0.0f;
+    for (int x = 0; x < channelCount; x++)
+    {
+      for (int y = 0; y < channelCount; y++)
+      {
+        next[x] += covariance[x][y] * axis[y];
+      }
+      length = std::max(length, std::fabs(next[x]));
+    }
+    if (length < 1e-6f)
+    {
+      break;
+    }
+    for (int c = 0; c < 4; c++)
+    {
+      axis[c] = next[c] / length;
+    }
+  }
+  float axisLength = 0.0f;
+  for (int c = 0; c < 4; c++)
+  {
+    axisLength += axis[c] * axis[c];
+  }
+  if (axisLength < 1e-12f)
+  {
+    //flat block
+    for (int c = 0; c < 4; c++)
+    {
+      e0[c] = e1[c] = mean[c];
+    }
+    return;
+  }
+  float low = 3.0e38f, high = -3.0e38f;
+  for (int i = 0; i < 16; i++)
+  {
+    float pixel[4];
+    pixelAt(block, i, pixel);
+    float projection = 0.0f;
+    for (int c = 0; c < 4; c++)
+    {
+      projection += (pixel[c] - mean[c]) * axis[c];
+    }
+    low = std::min(low, projection);
+    high = std::max(high, projection);
+  }
+  for (int c = 0; c < 4; c++)
+  {
+    e0[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * high / axisLength));
+    e1[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * low / axisLength));
+  }
+}
+
+/*
+* Least squares endpoints for fixed indices: each pixel is modelled as
+* (1 - t) * e0 + t * e1 where t is the interpolation weight of its index.
+* Returns false when every pixel uses the same weight.
+*/
+static bool refineEndpoints(const Block &block, const uint8_t indices[16], const float *weights, float e0[4], float e1[4])
+{
+  float aa = 0, ab = 0, bb = 0;
+  float ax[4] = {0, 0, 0, 0}, bx[4] = {0, 0, 0, 0};
+  for (int i = 0; i < 16; i++)
+  {
+    float t = weights[indices[i]];
+    float pixel[4];
+    pixelAt(block, i, pixel);
+    aa += (1 - t) * (1 - t);
+    ab += (1 - t) * t;
+    bb += t * t;
+    for (int c = 0; c < 4; c++)
+    {
+      ax[c] += (1 - t) * pixel[c];
+      bx[c] += t * pixel[c];
+    }
+  }
+  float determinant = aa * bb - ab * ab;
+  if (std::fabs(determinant) < 1e-6f)
+  {
+    return false;
+  }
+  for (int c = 0; c < 4; c++)
+  {
+    e0[c] = std::min(255.0f, std::max(0.0f, (ax[c] * bb - bx[c] * ab) / determinant));
+    e1[c] = std::min(255.0f, std::max(0.0f, (bx[c] * aa - ax[c] * ab) / determinant));
+  }
+  return true;
+}
+
+//---- BC1 ----
+
+static uint16_t packRGB565(const float color[4])
+{
+  int r = (int)std::lround(color[0] * 31.0f / 255.0f);
+  int g = (int)std::lround(color[1] * 63.0f / 255.0f);
+  int b = (int)std::lround(color[2] * 31.0f / 255.0f);
+  return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static Color unpackRGB565(uint16_t packed)
+{
+  int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+  return {{(float)((r << 3) | (r >> 2)), (float)((g << 2) | (g >> 4)), (float)((b << 3) | (b >> 2)), 255.0f}};
+}
+
+//4 colour palette in BC1 index order: e0, e1, 2/3 e0 + 1/3 e1, 1/3 e0 + 2/3 e1
+static void bc1Palette(uint16_t c0, uint16_t c1, Color palette[4])
+{
+  palette[0] = unpackRGB565(c0);
+  palette[1] = unpackRGB565(c1);
+  for (int c = 0; c < 4; c++)
+  {
+    palette[2].c[c] = (2 * palette[0].c[c] + palette[1].c[c]) / 3.0f;
+    palette[3].c[c] = (palette[0].c[c] + 2 * palette[1].c[c]) / 3.0f;
+  }
+}
+
+static float bc1Try(const Block &block, const float e0[4], const float e1[4], uint16_t &c0, uint16_t &c1, uint8_t indices[16])
+{
+  c0 = packRGB565(e0);
+  c1 = packRGB565(e1);
+  //c0 > c1 selects the 4 colour mode, which is also the only one BC3 knows about
+  if (c0 < c1)
+  {
+    std::swap(c0, c1);
+  }
+  if (c0 == c1)
+  {
+    Color palette[1] = {unpackRGB565(c0)};
+    return findIndices(block, palette, 1, false, indices);
+  }
+  Color palette[4];
+  bc1Palette(c0, c1, palette);
+  return findIndices(block, palette, 4, false, indices);
+}
+
+static void encodeBC1(const Block &block, EncodeQuality quality, unsigned char *out)
+{
+  static const float weights[4] = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+  float e0[4], e1[4];
+  chooseEndpoints(block, 3, quality, e0, e1);
+  uint16_t c0, c1;
+  uint8_t indices[16];
+  float error = bc1Try(block, e0, e1, c0, c1, indices);
+  int iterations = quality == EncodeQuality::High ? 2 : 0;
+  for (int i = 0; i < iterations && c0 != c1; i++)
+  {
+    float r0[4], r1[4];
+    if (!refineEndpoints(block, indices, weights, r0, r1))
+    {
+      break;
+    }
+    uint16_t t0, t1;
+    uint8_t tryIndices[16];
+    float tryError = bc1Try(block, r0, r1, t0, t1, tryIndices);
+    if (tryError >= error)
+    {
+      break;
+    }
+    error = tryError;
+    c0 = t0;
+    c1 = t1;
+    memcpy(indices, tryIndices, sizeof(indices));
+  }
+  uint32_t bits = 0;
+  for (int i = 0; i < 16; i++)
+  {
+    bits |= (uint32_t)indices[i] << (i * 2);
+  }
+  out[0] = c0 & 0xFF;
+  out[1] = c0 >> 8;
+  out[2] = c1 & 0xFF;
+  out[3] = c1 >> 8;
+  for (int i = 0; i < 4; i++)
+  {
+    out[4 + i] = (bits >> (i * 8)) & 0xFF;
+  }
+}
+
+//---- BC3 ----
+
+//alpha palette for a0 > a1 (8 interpolated values) or a0 <= a1 (6 values plus 0 and 255)
+static void alphaPalette(int a0, int a1, int palette[8])
+{
+  palette[0] = a0;
+  palette[1] = a1;
+  if (a0 > a1)
+  {
+    for (int i = 1; i < 7; i++)
+    {
+      palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+    }
+  }
+  else
+  {
+    for (int i = 1; i < 5; i++)
+    {
+      palette[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+    }
+    palette[6] = 0;
+    palette[7] = 255;
+  }
+}
+
+static int alphaTry(const Block &block, int a0, int a1, uint8_t indices[16])
+{
+  int palette[8];
+  alphaPalette(a0, a1, palette);
+  int error = 0;
+  for (int i = 0; i < 16; i++)
+  {
+    int best = 1 << 30;
+    for (int p = 0; p < 8; p++)
+    {
+      int distance = std::abs((int)block.a[i] - palette[p]);
+      if (distance < best)
+      {
+        best = distance;
+        indices[i] = (uint8_t)p;
+      }
+    }
+    error += best * best;
+  }
+  return error;
+}
+
+static void encodeAlphaBlock(const Block &block, EncodeQuality quality, unsigned char *out)
+{
+  int low = 255, high = 0, innerLow = 255, innerHigh = 0;
+  for (int i = 0; i < 16; i++)
+  {
+    int alpha = (int)block.a[i];
+    low = std::min(low, alpha);
+    high = std::max(high, alpha);
+    if (alpha != 0 && alpha != 255)
+    {
+      innerLow = std::min(innerLow, alpha);
+      innerHigh = std::max(innerHigh, alpha);
+    }
+  }
+  uint8_t indices[16];
+  int a0 = high, a1 = low;
+  int error = alphaTry(block, a0, a1, indices);
+  //the 6 value mode wins on blocks mixing fully (un)covered pixels with soft edges
+  if (quality == EncodeQuality::High && innerLow <= innerHigh)
+  {
+    uint8_t tryIndices[16];
+    int tryError = alphaTry(block, innerLow, innerHigh, tryIndices);
+    if (tryError < error)
+    {
+      a0 = innerLow;
+      a1 = innerHigh;
+      memcpy(indices, tryIndices, sizeof(indices));
+    }
+  }
+  uint64_t bits = 0;
+  for (int i = 0; i < 16; i++)
+  {
+    bits |= (uint64_t)indices[i] << (i * 3);
+  }
+  out[0] = (unsigned char)a0;
+  out[1] = (unsigned char)a1;
+  for (int i = 0; i < 6; i++)
+  {
+    out[2 + i] = (bits >> (i * 8)) & 0xFF;
+  }
+}
+
+static void encodeBC3(const Block &block, EncodeQuality quality, unsigned char *out)
+{
+  encodeAlphaBlock(block, quality, out);
+  encodeBC1(block, quality, out + 8);
+}
+
+//---- BC7 (mode 6) ----
+
+static const float bc7Weights[16] = {0 / 64.0f, 4 / 64.0f, 9 / 64.0f, 13 / 64.0f, 17 / 64.0f, 21 / 64.0f, 26 / 64.0f, 30 / 64.0f,
+                                     34 / 64.0f, 38 / 64.0f, 43 / 64.0f, 47 / 64.0f, 51 / 64.0f, 55 / 64.0f, 60 / 64.0f, 64 / 64.0f};
+
+//7 bits per channel plus one p-bit shared by the 4 channels of an endpoint
+struct BC7Endpoint
+{
+  int value[4];
+  int pbit;
+};
+
+static BC7Endpoint quantizeBC7(const float color[4])
+{
+  BC7Endpoint best = {};
+  float bestError = 3.0e38f;
+  for (int pbit = 0; pbit < 2; pbit++)
+  {
+    BC7Endpoint endpoint;
+    endpoint.pbit = pbit;
+    float error = 0.0f;
+    for (int c = 0; c < 4; c++)
+    {
+      endpoint.value[c] = std::min(127, std::max(0, (int)std::lround((color[c] - pbit) / 2.0f)));
+      float restored = (float)((endpoint.value[c] << 1) | pbit);
+      error += (restored - color[c]) * (restored - color[c]);
+    }
+    if (error < bestError)
+    {
+      bestError = error;
+      best = endpoint;
+    }
+  }
+  return best;
+}
+
+static float bc7Try(const Block &block, const float e0[4], const float e1[4], BC7Endpoint endpoints[2], uint8_t indices[16])
+{
+  endpoints[0] = quantizeBC7(e0);
+  endpoints[1] = quantizeBC7(e1);
+  Color palette[16];
+  for (int i = 0; i < 16; i++)
+  {
+    int weight = (int)std::lround(bc7Weights[i] * 64.0f);
+    for (int c = 0; c < 4; c++)
+    {
+      int a = (endpoints[0].value[c] << 1) | endpoints[0].pbit;
+      int b = (endpoints[1].value[c] << 1) | endpoints[1].pbit;
+      palette[i].c[c] = (float)(((64 - weight) * a + weight * b + 32) >> 6);
+    }
+  }
+  return findIndices(block, palette, 16, true, indices);
+}
+
+//little endian bit stream into a 16 byte block
+struct BitWriter
+{
+  unsigned char *out;
+  int position = 0;
+
+  void write(uint32_t value, int bits)
+  {
+    for (int i = 0; i < bits; i++, position++)
+    {
+      out[position >> 3] |= ((value >> i) & 1) << (position & 7);
+    }
+  }
+};
+
+static void encodeBC7(const Block &block, EncodeQuality quality, unsigned char *out)
+{
+  float e0[4], e1[4];
+  chooseEndpoints(block, 4, quality, e0, e1);
+  BC7Endpoint endpoints[2];
+  uint8_t indices[16];
+  float error = bc7Try(block, e0, e1, endpoints, indices);
+  int iterations = quality == EncodeQuality::High ? 2 : 0;
+  for (int i = 0; i < iterations; i++)
+  {
+    float r0[4], r1[4];
+    if (!refineEndpoints(block, indices, bc7Weights, r0, r1))
+    {
+      break;
+    }
+    BC7Endpoint tryEndpoints[2];
+    uint8_t tryIndices[16];
+    float tryError = bc7Try(block, r0, r1, tryEndpoints, tryIndices);
+    if (tryError >= error)
+    {
+      break;
+    }
+    error = tryError;
+    endpoints[0] = tryEndpoints[0];
+    endpoints[1] = tryEndpoints[1];
+    memcpy(indices, tryIndices, sizeof(indices));
+  }
+  //the anchor (first) index drops its top bit, so it has to be < 8
+  if (indices[0] >= 8)
+  {
+    std::swap(endpoints[0], endpoints[1]);
+    for (int i = 0; i < 16; i++)
+    {
+      indices[i] = 15 - indices[i];
+    }
+  }
+  memset(out, 0, 16);
+  BitWriter writer{out};
+  writer.write(1 << 6, 7); //mode 6
+  for (int c = 0; c < 4; c++)
+  {
+    writer.write(endpoints[0].value[c], 7);
+    writer.write(endpoints[1].value[c], 7);
+  }
+  writer.write(endpoints[0].pbit, 1);
+  writer.write(endpoints[1].pbit, 1);
+  writer.write(indices[0], 3);
+  for (int i = 1; i < 16; i++)
+  {
+    writer.write(indices[i], 4);
+  }
+}
+
+static void encodeRows(const unsigned char *pixels, int width, int height, int channels, const TextureCompression &settings,
+                       int firstRow, int lastRow, unsigned char *out)
+{
+  int blocksWide = (width + 3) / 4;
+  size_t bytes = blockBytes(settings.format);
+  Block block;
+  for (int y = firstRow; y < lastRow; y++)
+  {
+    for (int x = 0; x < blocksWide; x++)
+    {
+      loadBlock(pixels, width, height, channels, x, y, block);
+      unsigned char *destination = out + ((size_t)y * blocksWide + x) * bytes;
+      switch (settings.format)
+      {
+        case BlockFormat::BC1: encodeBC1(block, settings.quality, destination); break;
+        case BlockFormat::BC3: encodeBC3(block, settings.quality, destination); break;
+        case BlockFormat::BC7: encodeBC7(block, settings.quality, destination); break;
+        default: break;
+      }
+    }
+  }
+}
+
+std::vector<unsigned char> encodeBlocks(const unsigned char *pixels, int width, int height, int channels,
+                                        const TextureCompression &settings, ThreadPool *pool)
+{
+  std::vector<unsigned char> blocks(compressedLevelSize(settings.format, width, height));
+  if (blocks.empty())
+  {
+    return blocks;
+  }
+  int blocksHigh = (height + 3) / 4;
+  if (!pool || blocksHigh < 2)
+  {
+    encodeRows(pixels, width, height, channels, settings, 0, blocksHigh, blocks.data());
+    return blocks;
+  }
+  //a few chunks per worker keeps them busy when some rows are slower than others
+  int chunks = std::min(blocksHigh, (int)pool->size() * 4);
+  std::vector<std::future<void>> jobs;
+  for (int chunk = 0; chunk < chunks; chunk++)
+  {
+    int first = blocksHigh * chunk / chunks;
+    int last = blocksHigh * (chunk + 1) / chunks;
+    unsigned char *out = blocks.data();
+    jobs.push_back(pool->submit([=, &settings]() { encodeRows(pixels, width, height, channels, settings, first, last, out); }));
+  }
+  for (std::future<void> &job : jobs)
+  {
+    job.get();
+  }
+  return blocks;
+}
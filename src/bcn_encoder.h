@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+class ThreadPool;
+
+/*
+* CPU block compression for 8 bit images.
+*  BC1: 4 bpp RGB, what every opaque texture should use by default
+*  BC3: 8 bpp, BC1 colour plus a separate alpha block
+*  BC7: 8 bpp, mode 6 only (one subset, RGBA endpoints with p-bits, 16 levels);
+*       noticeably better colour than BC1 at twice the size
+* The quality knob trades endpoint search effort for speed:
+*  Fast: bounding box endpoints
+*  Normal: principal axis endpoints
+*  High: principal axis plus least squares refinement
+* Index selection runs 4 pixels at a time with SSE2 when it is available.
+*/
+enum class BlockFormat { None, BC1, BC3, BC7 };
+enum class EncodeQuality { Fast, Normal, High };
+
+struct TextureCompression
+{
+  BlockFormat format = BlockFormat::None;
+  EncodeQuality quality = EncodeQuality::Normal;
+};
+
+//bytes per 4x4 block, 0 for BlockFormat::None
+size_t blockBytes(BlockFormat format);
+//bytes of one encoded level, partial blocks on the edges count as whole ones
+size_t compressedLevelSize(BlockFormat format, int width, int height);
+
+//encodes a tightly packed 1-4 channel image, blocks in row major order
+//rows of blocks are spread over the pool when one is given; the pool must not be
+//the one the caller is running on, the call waits for its own jobs
+std::vector<unsigned char> encodeBlocks(const unsigned char *pixels, int width, int height, int channels,
+                                        const TextureCompression &settings, ThreadPool *pool = nullptr);
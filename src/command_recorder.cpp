@@ -0,0 +1,37 @@
+#include "command_recorder.h"
+#include "cpu_profiler.h"
+
+void CommandRecorder::record(size_t regions, const RecordFunction &recordRegion, RenderQueue &queue)
+{
+  CPU_ZONE("CommandRecorder::record");
+  if (!regions)
+  {
+    return;
+  }
+  if (lists.size() < regions)
+  {
+    lists.resize(regions);
+  }
+  jobs.clear();
+  for (size_t region = 0; region + 1 < regions; region++)
+  {
+    CommandList *list = &lists[region];
+    list->clear();
+    jobs.push_back(pool.submit([list, region, &recordRegion]() { recordRegion(*list, region); }));
+  }
+  lists[regions - 1].clear();
+  recordRegion(lists[regions - 1], regions - 1);
+  //every job references this frame's lists, let all of them finish before rethrowing a failure
+  for (std::future<void> &job : jobs)
+  {
+    job.wait();
+  }
+  for (std::future<void> &job : jobs)
+  {
+    job.get();
+  }
+  for (size_t region = 0; region < regions; region++)
+  {
+    queue.append(lists[region]);
+  }
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "render_queue.h"
+#include "thread_pool.h"
+#include <functional>
+
+/*
+* Builds a frame's draws in parallel.
+* The frame is split into regions (a pass, a chunk of the scene, ...) and
+* each region records into its own CommandList on the pool, the calling
+* thread taking the last one itself so it never just waits. Once all are
+* done the lists are appended to the queue in region order, so the result
+* does not depend on which thread finished first, and the GL thread
+* replays them with RenderQueue::execute().
+* Record functions must not make GL calls; anything they read from the
+* scene has to stay unchanged until record() returns.
+*/
+class CommandRecorder
+{
+  public:
+    typedef std::function<void(CommandList &list, size_t region)> RecordFunction;
+
+    explicit CommandRecorder(ThreadPool &pool) : pool(pool) {}
+
+    //blocks until every region is recorded and appended to queue
+    void record(size_t regions, const RecordFunction &recordRegion, RenderQueue &queue);
+
+  private:
+    ThreadPool &pool;
+    //one per region, kept so their memory is reused next frame
+    std::vector<CommandList> lists;
+    std::vector<std::future<void>> jobs;
+};
@@ -0,0 +1,164 @@
+#include "cpu_profiler.h"
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> cpuProfilerActive(false);
+
+namespace
+{
+  struct ZoneEvent
+  {
+    const char *name;
+    uint64_t begin;
+    uint64_t end;
+  };
+
+  //written only by the owning thread; count is published after the event is
+  struct ZoneChunk
+  {
+    static const size_t CAPACITY = 4096;
+    ZoneEvent events[CAPACITY];
+    std::atomic<size_t> count{0};
+    std::atomic<ZoneChunk*> next{nullptr};
+  };
+
+  struct ThreadZones
+  {
+    uint32_t id;
+    //guarded by the registry mutex
+    std::string name;
+    //allocated with the first zone, threads that never record one cost no chunk
+    std::atomic<ZoneChunk*> first{nullptr};
+    //only touched by the owning thread
+    ZoneChunk *last = nullptr;
+    size_t chunks = 0;
+  };
+
+  //a thread stops recording after this many chunks (1M zones)
+  const size_t MAX_CHUNKS = 256;
+
+  std::mutex registryMutex;
+  std::vector<std::unique_ptr<ThreadZones>> registry;
+  std::vector<std::unique_ptr<ZoneChunk>> chunkStorage;
+  std::atomic<uint64_t> dropped(0);
+  const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+  thread_local ThreadZones *threadZones = nullptr;
+
+  //the calling thread's buffer, registered on first use (the only time a lock is taken)
+  ThreadZones &zonesForThread()
+  {
+    if (!threadZones)
+    {
+      std::lock_guard<std::mutex> lock(registryMutex);
+      registry.push_back(std::unique_ptr<ThreadZones>(new ThreadZones()));
+      threadZones = registry.back().get();
+      threadZones->id = (uint32_t)registry.size();
+    }
+    return *threadZones;
+  }
+
+  void writeEscaped(FILE *file, const char *text)
+  {
+    for (; *text; text++)
+    {
+      if (*text == '"' || *text == '\\')
+      {
+        fputc('\\', file);
+      }
+      if ((unsigned char)*text >= 0x20)
+      {
+        fputc(*text, file);
+      }
+    }
+  }
+}
+
+void setCpuProfilerEnabled(bool enabled)
+{
+  cpuProfilerActive.store(enabled, std::memory_order_relaxed);
+}
+
+void setProfilerThreadName(const std::string &name)
+{
+  ThreadZones &zones = zonesForThread();
+  std::lock_guard<std::mutex> lock(registryMutex);
+  zones.name = name;
+}
+
+uint64_t profilerNow()
+{
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void recordCpuZone(const char *name, uint64_t begin, uint64_t end)
+{
+  ThreadZones &zones = zonesForThread();
+  ZoneChunk *chunk = zones.last;
+  size_t count = chunk ? chunk->count.load(std::memory_order_relaxed) : ZoneChunk::CAPACITY;
+  if (count == ZoneChunk::CAPACITY)
+  {
+    if (zones.chunks == MAX_CHUNKS)
+    {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    ZoneChunk *next = new ZoneChunk();
+    {
+      //ownership only, readers follow next without the lock
+      std::lock_guard<std::mutex> lock(registryMutex);
+      chunkStorage.push_back(std::unique_ptr<ZoneChunk>(next));
+    }
+    (chunk ? chunk->next : zones.first).store(next, std::memory_order_release);
+    zones.last = chunk = next;
+    zones.chunks++;
+    count = 0;
+  }
+  chunk->events[count] = {name, begin, end};
+  chunk->count.store(count + 1, std::memory_order_release);
+}
+
+bool writeChromeTrace(const std::string &path)
+{
+  FILE *file = fopen(path.c_str(), "w");
+  if (!file)
+  {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(registryMutex);
+  fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", file);
+  bool firstEvent = true;
+  for (const std::unique_ptr<ThreadZones> &zones : registry)
+  {
+    if (!zones->name.empty())
+    {
+      fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"", firstEvent ? "" : ",\n", zones->id);
+      writeEscaped(file, zones->name.c_str());
+      fputs("\"}}", file);
+      firstEvent = false;
+    }
+    for (const ZoneChunk *chunk = zones->first.load(std::memory_order_acquire); chunk; chunk = chunk->next.load(std::memory_order_acquire))
+    {
+      size_t count = chunk->count.load(std::memory_order_acquire);
+      for (size_t i = 0; i < count; i++)
+      {
+        const ZoneEvent &event = chunk->events[i];
+        //complete events, timestamps in microseconds
+        fprintf(file, "%s{\"name\":\"", firstEvent ? "" : ",\n");
+        writeEscaped(file, event.name);
+        fprintf(file, "\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                zones->id, event.begin / 1000.0, (event.end - event.begin) / 1000.0);
+        firstEvent = false;
+      }
+    }
+  }
+  fputs("\n]}\n", file);
+  return fclose(file) == 0;
+}
+
+uint64_t droppedCpuZones()
+{
+  return dropped.load(std::memory_order_relaxed);
+}
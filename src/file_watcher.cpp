@@ -0,0 +1,116 @@
+#include "file_watcher.h"
+#include <algorithm>
+#include <iostream>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+static std::string directoryOf(const std::string &path)
+{
+  size_t slash = path.find_last_of('/');
+  return slash == std::string::npos ? "." : path.substr(0, slash);
+}
+
+static std::string fileNameOf(const std::string &path)
+{
+  size_t slash = path.find_last_of('/');
+  return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+static long long modifiedTime(const std::string &path)
+{
+  struct stat info;
+  if (stat(path.c_str(), &info) != 0)
+  {
+    return 0;
+  }
+  return (long long)info.st_mtime;
+}
+
+FileWatcher::FileWatcher()
+{
+#ifdef __linux__
+  fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd < 0)
+  {
+    std::cout << "File watcher: inotify unavailable, polling modification times" << std::endl;
+  }
+#endif
+}
+
+FileWatcher::~FileWatcher()
+{
+#ifdef __linux__
+  if (fd >= 0)
+  {
+    close(fd);
+  }
+#endif
+}
+
+bool FileWatcher::watch(const std::string &path)
+{
+  files[path] = modifiedTime(path);
+#ifdef __linux__
+  if (fd >= 0)
+  {
+    std::string directory = directoryOf(path);
+    //watching a directory twice hands back the same descriptor
+    int wd = inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+    if (wd < 0)
+    {
+      std::cout << "File watcher: cannot watch " << directory << std::endl;
+      return false;
+    }
+    directories[wd] = directory;
+  }
+#endif
+  return true;
+}
+
+std::vector<std::string> FileWatcher::changes()
+{
+  std::vector<std::string> changed;
+#ifdef __linux__
+  if (fd >= 0)
+  {
+    alignas(struct inotify_event) char buffer[4096];
+    ssize_t length;
+    while ((length = read(fd, buffer, sizeof(buffer))) > 0)
+    {
+      for (char *at = buffer; at < buffer + length;)
+      {
+        const struct inotify_event *event = (const struct inotify_event*)at;
+        at += sizeof(struct inotify_event) + event->len;
+        auto directory = directories.find(event->wd);
+        if (directory == directories.end() || !event->len)
+        {
+          continue;
+        }
+        //map the event back onto the spelling the caller used
+        for (const auto &file : files)
+        {
+          if (directoryOf(file.first) == directory->second && fileNameOf(file.first) == event->name
+              && std::find(changed.begin(), changed.end(), file.first) == changed.end())
+          {
+            changed.push_back(file.first);
+          }
+        }
+      }
+    }
+    return changed;
+  }
+#endif
+  for (auto &file : files)
+  {
+    long long modified = modifiedTime(file.first);
+    if (modified != file.second)
+    {
+      file.second = modified;
+      changed.push_back(file.first);
+    }
+  }
+  return changed;
+}
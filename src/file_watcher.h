@@ -0,0 +1,32 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+* Reports files that changed on disk, without ever blocking.
+* On Linux this is inotify on each file's directory: editors often save by
+* writing a new file and renaming it over the old one, which a watch on the
+* file itself would lose. Elsewhere it falls back to comparing modification
+* times on every call.
+*/
+class FileWatcher
+{
+  public:
+    FileWatcher();
+    ~FileWatcher();
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    //false (and logs) if the file's directory cannot be watched
+    bool watch(const std::string &path);
+    //watched paths written since the last call, each once, as they were passed to watch()
+    std::vector<std::string> changes();
+
+  private:
+    int fd = -1;
+    //inotify watch descriptor -> directory
+    std::unordered_map<int, std::string> directories;
+    //watched path -> last modification time (only used without inotify)
+    std::unordered_map<std::string, long long> files;
+};
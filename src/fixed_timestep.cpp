@@ -0,0 +1,35 @@
+#include "fixed_timestep.h"
+#include <math.h>
+
+FixedTimestep::FixedTimestep(double tickSeconds, int maxTicksPerFrame)
+  : tickSeconds(tickSeconds), maxTicksPerFrame(maxTicksPerFrame)
+{
+}
+
+int FixedTimestep::advance(double now)
+{
+  //the first frame only starts the clock
+  if (lastTime < 0.0)
+  {
+    lastTime = now;
+    return 0;
+  }
+  double elapsed = now - lastTime;
+  lastTime = now;
+  accumulator += elapsed > 0.0 ? elapsed : 0.0;
+  int steps = 0;
+  while (accumulator >= tickSeconds && steps < maxTicksPerFrame)
+  {
+    accumulator -= tickSeconds;
+    steps++;
+  }
+  if (accumulator >= tickSeconds)
+  {
+    //keep the fraction so alpha() stays continuous, drop whole ticks
+    double backlog = accumulator - fmod(accumulator, tickSeconds);
+    dropped += backlog;
+    accumulator -= backlog;
+  }
+  tickCount += steps;
+  return steps;
+}
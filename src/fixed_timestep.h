@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdint>
+
+/*
+* Runs simulation at a fixed rate, independent of how often frames are drawn.
+* Each frame advance() is given the current time and says how many ticks of
+* tickSeconds to simulate to catch up; rendering then blends the last two
+* simulated states by alpha(), so motion is smooth on a 60 Hz and a 240 Hz
+* display alike while every tick costs the same.
+* If frames are slow (or the process was stopped in a debugger) at most
+* maxTicksPerFrame run and the rest of the backlog is dropped, so one slow
+* frame never turns into a spiral of ever longer catch-up frames.
+*/
+class FixedTimestep
+{
+  public:
+    explicit FixedTimestep(double tickSeconds = 1.0 / 60.0, int maxTicksPerFrame = 5);
+
+    //number of ticks to simulate this frame, now in seconds (e.g. glfwGetTime())
+    int advance(double now);
+    //how far rendering is between the previous tick and the latest one, in [0, 1)
+    float alpha() const { return (float)(accumulator / tickSeconds); }
+
+    double tick() const { return tickSeconds; }
+    uint64_t ticks() const { return tickCount; }
+    //seconds of simulation skipped because of the catch-up cap
+    double droppedTime() const { return dropped; }
+
+  private:
+    double tickSeconds;
+    int maxTicksPerFrame;
+    double lastTime = -1.0;
+    double accumulator = 0.0;
+    uint64_t tickCount = 0;
+    double dropped = 0.0;
+};
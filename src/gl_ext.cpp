@@ -0,0 +1,102 @@
+#include "gl_ext.h"
+#include "texture_formats.h"
+#include <cstring>
+
+PFNGLTEXSTORAGE2DPROC glext_glTexStorage2D = NULL;
+PFNGLTEXSTORAGE3DPROC glext_glTexStorage3D = NULL;
+int GLEXT_ARB_texture_storage = 0;
+
+PFNGLBUFFERSTORAGEPROC glext_glBufferStorage = NULL;
+int GLEXT_ARB_buffer_storage = 0;
+
+PFNGLGETPROGRAMBINARYPROC glext_glGetProgramBinary = NULL;
+PFNGLPROGRAMBINARYPROC glext_glProgramBinary = NULL;
+PFNGLPROGRAMPARAMETERIPROC glext_glProgramParameteri = NULL;
+int GLEXT_ARB_get_program_binary = 0;
+
+PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glext_glMaxShaderCompilerThreadsKHR = NULL;
+int GLEXT_KHR_parallel_shader_compile = 0;
+
+PFNGLPUSHDEBUGGROUPPROC glext_glPushDebugGroup = NULL;
+PFNGLPOPDEBUGGROUPPROC glext_glPopDebugGroup = NULL;
+int GLEXT_KHR_debug = 0;
+
+int GLEXT_EXT_texture_compression_s3tc = 0;
+int GLEXT_ARB_texture_compression_bptc = 0;
+
+static bool versionAtLeast(int major, int minor)
+{
+  return GLVersion.major > major || (GLVersion.major == major && GLVersion.minor >= minor);
+}
+
+bool hasGLExtension(const char *name)
+{
+  GLint count = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+  for (GLint i = 0; i < count; i++)
+  {
+    const char *extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+    if (extension && strcmp(extension, name) == 0)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+void loadGLExtensions(GLADloadproc load)
+{
+  if (versionAtLeast(4, 2) || hasGLExtension("GL_ARB_texture_storage"))
+  {
+    glext_glTexStorage2D = (PFNGLTEXSTORAGE2DPROC)load("glTexStorage2D");
+    glext_glTexStorage3D = (PFNGLTEXSTORAGE3DPROC)load("glTexStorage3D");
+    GLEXT_ARB_texture_storage = glext_glTexStorage2D != NULL && glext_glTexStorage3D != NULL;
+  }
+  if (versionAtLeast(4, 4) || hasGLExtension("GL_ARB_buffer_storage"))
+  {
+    glext_glBufferStorage = (PFNGLBUFFERSTORAGEPROC)load("glBufferStorage");
+    GLEXT_ARB_buffer_storage = glext_glBufferStorage != NULL;
+  }
+  if (versionAtLeast(4, 1) || hasGLExtension("GL_ARB_get_program_binary"))
+  {
+    glext_glGetProgramBinary = (PFNGLGETPROGRAMBINARYPROC)load("glGetProgramBinary");
+    glext_glProgramBinary = (PFNGLPROGRAMBINARYPROC)load("glProgramBinary");
+    glext_glProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)load("glProgramParameteri");
+    //some drivers expose the entry points but no format to save in
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    GLEXT_ARB_get_program_binary = glext_glGetProgramBinary != NULL && glext_glProgramBinary != NULL
+                                 && glext_glProgramParameteri != NULL && formats > 0;
+  }
+  if (hasGLExtension("GL_KHR_parallel_shader_compile"))
+  {
+    glext_glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)load("glMaxShaderCompilerThreadsKHR");
+  }
+  else if (hasGLExtension("GL_ARB_parallel_shader_compile"))
+  {
+    glext_glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)load("glMaxShaderCompilerThreadsARB");
+  }
+  GLEXT_KHR_parallel_shader_compile = glext_glMaxShaderCompilerThreadsKHR != NULL;
+  if (versionAtLeast(4, 3) || hasGLExtension("GL_KHR_debug"))
+  {
+    glext_glPushDebugGroup = (PFNGLPUSHDEBUGGROUPPROC)load("glPushDebugGroup");
+    glext_glPopDebugGroup = (PFNGLPOPDEBUGGROUPPROC)load("glPopDebugGroup");
+    GLEXT_KHR_debug = glext_glPushDebugGroup != NULL && glext_glPopDebugGroup != NULL;
+  }
+  GLEXT_EXT_texture_compression_s3tc = hasGLExtension("GL_EXT_texture_compression_s3tc");
+  GLEXT_ARB_texture_compression_bptc = versionAtLeast(4, 2) || hasGLExtension("GL_ARB_texture_compression_bptc");
+}
+
+bool textureFormatSupported(GLenum internalFormat)
+{
+  switch (internalFormat)
+  {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+      return GLEXT_EXT_texture_compression_s3tc != 0;
+    case GL_COMPRESSED_RGBA_BPTC_UNORM:
+      return GLEXT_ARB_texture_compression_bptc != 0;
+    default:
+      return true;
+  }
+}
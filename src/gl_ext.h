@@ -0,0 +1,75 @@
+#pragma once
+#include "config.h"
+
+/*
+* The glad loader in dependencies/ was generated for plain GL 3.3, so it knows
+* nothing about newer entry points. The few we use are loaded here the same
+* way glad does it: a function pointer plus a macro with the GL name, and an
+* int flag per feature that is set when the driver exposes it either through
+* its core version or the matching extension.
+* Every caller has to check the flag and keep a GL 3.3 fallback.
+*/
+
+//GL 4.2 / ARB_texture_storage
+typedef void (APIENTRYP PFNGLTEXSTORAGE2DPROC)(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height);
+typedef void (APIENTRYP PFNGLTEXSTORAGE3DPROC)(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height, GLsizei depth);
+extern PFNGLTEXSTORAGE2DPROC glext_glTexStorage2D;
+extern PFNGLTEXSTORAGE3DPROC glext_glTexStorage3D;
+#define glTexStorage2D glext_glTexStorage2D
+#define glTexStorage3D glext_glTexStorage3D
+extern int GLEXT_ARB_texture_storage;
+
+//GL 4.4 / ARB_buffer_storage
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#define GL_CLIENT_STORAGE_BIT 0x0200
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+extern PFNGLBUFFERSTORAGEPROC glext_glBufferStorage;
+#define glBufferStorage glext_glBufferStorage
+extern int GLEXT_ARB_buffer_storage;
+
+//GL 4.1 / ARB_get_program_binary, only set when the driver offers at least one binary format
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+extern PFNGLGETPROGRAMBINARYPROC glext_glGetProgramBinary;
+extern PFNGLPROGRAMBINARYPROC glext_glProgramBinary;
+extern PFNGLPROGRAMPARAMETERIPROC glext_glProgramParameteri;
+#define glGetProgramBinary glext_glGetProgramBinary
+#define glProgramBinary glext_glProgramBinary
+#define glProgramParameteri glext_glProgramParameteri
+extern int GLEXT_ARB_get_program_binary;
+
+//KHR_parallel_shader_compile (or the older ARB one, same enums): compiles and links run on driver
+//threads and their status can be polled without waiting
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+extern PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glext_glMaxShaderCompilerThreadsKHR;
+#define glMaxShaderCompilerThreadsKHR glext_glMaxShaderCompilerThreadsKHR
+extern int GLEXT_KHR_parallel_shader_compile;
+
+//GL 4.3 / KHR_debug, only the debug groups that name spans of commands in tools like RenderDoc
+#define GL_DEBUG_SOURCE_APPLICATION 0x824A
+typedef void (APIENTRYP PFNGLPUSHDEBUGGROUPPROC)(GLenum source, GLuint id, GLsizei length, const GLchar *message);
+typedef void (APIENTRYP PFNGLPOPDEBUGGROUPPROC)(void);
+extern PFNGLPUSHDEBUGGROUPPROC glext_glPushDebugGroup;
+extern PFNGLPOPDEBUGGROUPPROC glext_glPopDebugGroup;
+#define glPushDebugGroup glext_glPushDebugGroup
+#define glPopDebugGroup glext_glPopDebugGroup
+extern int GLEXT_KHR_debug;
+
+//EXT_texture_compression_s3tc and GL 4.2 / ARB_texture_compression_bptc, enums in texture_formats.h
+extern int GLEXT_EXT_texture_compression_s3tc;
+extern int GLEXT_ARB_texture_compression_bptc;
+
+//call once after gladLoadGLLoader with the same loader
+void loadGLExtensions(GLADloadproc load);
+//true if the current context lists the extension
+bool hasGLExtension(const char *name);
+//false for block compressed formats the driver cannot sample
+bool textureFormatSupported(GLenum internalFormat);
@@ -0,0 +1,233 @@
+#include "gl_state.h"
+
+static const GLenum TRACKED_CAPABILITIES[] = {GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE, GL_SCISSOR_TEST};
+
+GLStateCache &glState()
+{
+  static GLStateCache state;
+  return state;
+}
+
+int GLStateCache::textureSlot(GLenum target)
+{
+  return target == GL_TEXTURE_2D ? 0 : target == GL_TEXTURE_2D_ARRAY ? 1 : -1;
+}
+
+int GLStateCache::capabilitySlot(GLenum capability)
+{
+  for (int i = 0; i < 4; i++)
+  {
+    if (TRACKED_CAPABILITIES[i] == capability)
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+void GLStateCache::invalidate()
+{
+  currentProgram = vertexArray = arrayBuffer = uniformBuffer = UNKNOWN;
+  for (UniformRange &range : uniformRanges)
+  {
+    range = {UNKNOWN, 0, 0};
+  }
+  activeUnit = UNKNOWN;
+  for (unsigned int unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+  {
+    textures[unit][0] = textures[unit][1] = samplers[unit] = UNKNOWN;
+  }
+  for (GLuint &capability : capabilities)
+  {
+    capability = UNKNOWN;
+  }
+  clearKnown = false;
+}
+
+void GLStateCache::useProgram(GLuint program)
+{
+  if (!same(currentProgram, program))
+  {
+    glUseProgram(program);
+  }
+}
+
+GLuint GLStateCache::program()
+{
+  if (currentProgram == UNKNOWN)
+  {
+    GLint bound = 0;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &bound);
+    currentProgram = (GLuint)bound;
+  }
+  return currentProgram;
+}
+
+void GLStateCache::bindVertexArray(GLuint array)
+{
+  if (!same(vertexArray, array))
+  {
+    glBindVertexArray(array);
+  }
+}
+
+void GLStateCache::bindBuffer(GLenum target, GLuint buffer)
+{
+  //the element array binding belongs to the VAO, like every target not listed it is not tracked
+  GLuint *shadow = target == GL_ARRAY_BUFFER ? &arrayBuffer : target == GL_UNIFORM_BUFFER ? &uniformBuffer : nullptr;
+  if (!shadow)
+  {
+    calls.issued++;
+    glBindBuffer(target, buffer);
+  }
+  else if (!same(*shadow, buffer))
+  {
+    glBindBuffer(target, buffer);
+  }
+}
+
+void GLStateCache::bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+  if (target != GL_UNIFORM_BUFFER || index >= MAX_UNIFORM_BINDINGS)
+  {
+    calls.issued++;
+    glBindBufferRange(target, index, buffer, offset, size);
+    return;
+  }
+  UniformRange &range = uniformRanges[index];
+  if (range.buffer == buffer && range.offset == offset && range.size == size)
+  {
+    calls.elided++;
+    return;
+  }
+  range = {buffer, offset, size};
+  calls.issued++;
+  glBindBufferRange(target, index, buffer, offset, size);
+  //binding a range binds the generic point as well
+  uniformBuffer = buffer;
+}
+
+void GLStateCache::activeTexture(unsigned int unit)
+{
+  if (!same(activeUnit, unit))
+  {
+    glActiveTexture(GL_TEXTURE0 + unit);
+  }
+}
+
+void GLStateCache::bindTexture(GLenum target, GLuint texture)
+{
+  int slot = textureSlot(target);
+  if (slot < 0 || activeUnit >= MAX_TEXTURE_UNITS)
+  {
+    calls.issued++;
+    glBindTexture(target, texture);
+    return;
+  }
+  if (!same(textures[activeUnit][slot], texture))
+  {
+    glBindTexture(target, texture);
+  }
+}
+
+void GLStateCache::bindTextureUnit(unsigned int unit, GLenum target, GLuint texture)
+{
+  int slot = textureSlot(target);
+  if (slot >= 0 && unit < MAX_TEXTURE_UNITS && textures[unit][slot] == texture)
+  {
+    //the unit switch is not needed either
+    calls.elided += 2;
+    return;
+  }
+  activeTexture(unit);
+  bindTexture(target, texture);
+}
+
+void GLStateCache::bindSampler(unsigned int unit, GLuint sampler)
+{
+  if (unit >= MAX_TEXTURE_UNITS)
+  {
+    calls.issued++;
+    glBindSampler(unit, sampler);
+  }
+  else if (!same(samplers[unit], sampler))
+  {
+    glBindSampler(unit, sampler);
+  }
+}
+
+void GLStateCache::setEnabled(GLenum capability, bool enabled)
+{
+  int slot = capabilitySlot(capability);
+  if (slot >= 0 && same(capabilities[slot], (GLuint)enabled))
+  {
+    return;
+  }
+  if (slot < 0)
+  {
+    calls.issued++;
+  }
+  if (enabled)
+  {
+    glEnable(capability);
+  }
+  else
+  {
+    glDisable(capability);
+  }
+}
+
+void GLStateCache::clearColor(float red, float green, float blue, float alpha)
+{
+  if (clearKnown && clear[0] == red && clear[1] == green && clear[2] == blue && clear[3] == alpha)
+  {
+    calls.elided++;
+    return;
+  }
+  clear[0] = red;
+  clear[1] = green;
+  clear[2] = blue;
+  clear[3] = alpha;
+  clearKnown = true;
+  calls.issued++;
+  glClearColor(red, green, blue, alpha);
+}
+
+void GLStateCache::deleteTextures(GLsizei count, const GLuint *names)
+{
+  //the GL unbinds deleted textures from every unit, so the shadow does too
+  for (GLsizei i = 0; i < count; i++)
+  {
+    for (unsigned int unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+    {
+      for (GLuint &bound : textures[unit])
+      {
+        bound = bound == names[i] ? 0 : bound;
+      }
+    }
+  }
+  glDeleteTextures(count, names);
+}
+
+void GLStateCache::deleteBuffers(GLsizei count, const GLuint *names)
+{
+  for (GLsizei i = 0; i < count; i++)
+  {
+    arrayBuffer = arrayBuffer == names[i] ? 0 : arrayBuffer;
+    uniformBuffer = uniformBuffer == names[i] ? 0 : uniformBuffer;
+    for (UniformRange &range : uniformRanges)
+    {
+      range = range.buffer == names[i] ? UniformRange{0, 0, 0} : range;
+    }
+  }
+  glDeleteBuffers(count, names);
+}
+
+void GLStateCache::deleteVertexArrays(GLsizei count, const GLuint *names)
+{
+  for (GLsizei i = 0; i < count; i++)
+  {
+    vertexArray = vertexArray == names[i] ? 0 : vertexArray;
+  }
+  glDeleteVertexArrays(count, names);
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+
+/*
+* Shadows the GL bindings the renderer changes every frame and drops calls
+* that would set what is already set: the program, the VAO, the array and
+* uniform buffer bindings (uniform ranges included), the texture bound to
+* each unit for GL_TEXTURE_2D and GL_TEXTURE_2D_ARRAY, samplers, a few
+* enable caps and the clear color.
+* This only works if every change of that state goes through here, so code
+* that binds behind its back must call invalidate() afterwards, and tracked
+* objects must be deleted through the delete* calls (GL resets bindings of
+* deleted objects, and names get reused). Programs need nothing: a deleted
+* program stays current, and keeps its name, until another one is used.
+* Untracked targets are passed straight through and counted as issued.
+* One context, so there is one instance: glState().
+*/
+class GLStateCache
+{
+  public:
+    static const unsigned int MAX_TEXTURE_UNITS = 16;
+    static const unsigned int MAX_UNIFORM_BINDINGS = 16;
+
+    GLStateCache() { invalidate(); }
+
+    void useProgram(GLuint program);
+    //the program in use, asked from the GL if nothing was set through here yet
+    GLuint program();
+    void bindVertexArray(GLuint vertexArray);
+    void bindBuffer(GLenum target, GLuint buffer);
+    void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+    void activeTexture(unsigned int unit);
+    //on the active unit
+    void bindTexture(GLenum target, GLuint texture);
+    //on a given unit, switching units only when the binding changes
+    void bindTextureUnit(unsigned int unit, GLenum target, GLuint texture);
+    void bindSampler(unsigned int unit, GLuint sampler);
+    void setEnabled(GLenum capability, bool enabled);
+    void clearColor(float red, float green, float blue, float alpha);
+
+    void deleteTextures(GLsizei count, const GLuint *textures);
+    void deleteBuffers(GLsizei count, const GLuint *buffers);
+    void deleteVertexArrays(GLsizei count, const GLuint *vertexArrays);
+
+    //forgets everything, the next call of each kind is always issued
+    void invalidate();
+
+    struct Counters
+    {
+      uint64_t issued = 0;
+      uint64_t elided = 0;
+    };
+    const Counters &counters() const { return calls; }
+    void resetCounters() { calls = Counters(); }
+
+  private:
+    //never a real GL name, marks state that has to be issued
+    static const GLuint UNKNOWN = 0xFFFFFFFF;
+    struct UniformRange
+    {
+      GLuint buffer;
+      GLintptr offset;
+      GLsizeiptr size;
+    };
+
+    //true if value already holds next, otherwise stores it; counts either way
+    template <typename T>
+    bool same(T &value, const T &next)
+    {
+      if (value == next)
+      {
+        calls.elided++;
+        return true;
+      }
+      value = next;
+      calls.issued++;
+      return false;
+    }
+    //slot of a tracked texture target, -1 for the rest
+    static int textureSlot(GLenum target);
+    //slot of a tracked capability, -1 for the rest
+    static int capabilitySlot(GLenum capability);
+
+    GLuint currentProgram;
+    GLuint vertexArray;
+    GLuint arrayBuffer;
+    GLuint uniformBuffer;
+    UniformRange uniformRanges[MAX_UNIFORM_BINDINGS];
+    unsigned int activeUnit;
+    GLuint textures[MAX_TEXTURE_UNITS][2];
+    GLuint samplers[MAX_TEXTURE_UNITS];
+    //0 off, 1 on, UNKNOWN
+    GLuint capabilities[4];
+    float clear[4];
+    bool clearKnown;
+    Counters calls;
+};
+
+GLStateCache &glState();
@@ -0,0 +1,185 @@
+#include "gpu_profiler.h"
+#include "gl_ext.h"
+#include <algorithm>
+#include <cstdio>
+
+GpuProfiler::GpuProfiler(unsigned int frameLatency, size_t samplesPerPass)
+  : frames(frameLatency ? frameLatency : 1), samplesPerPass(samplesPerPass ? samplesPerPass : 1)
+{
+}
+
+GpuProfiler::~GpuProfiler()
+{
+  for (Frame &frame : frames)
+  {
+    if (!frame.queries.empty())
+    {
+      glDeleteQueries((GLsizei)frame.queries.size(), frame.queries.data());
+    }
+  }
+}
+
+GLuint GpuProfiler::query(Frame &frame)
+{
+  if (frame.usedQueries == frame.queries.size())
+  {
+    GLuint name = 0;
+    glGenQueries(1, &name);
+    frame.queries.push_back(name);
+  }
+  return frame.queries[frame.usedQueries++];
+}
+
+void GpuProfiler::collect(Frame &frame)
+{
+  frame.pending = false;
+  if (frame.scopes.empty())
+  {
+    return;
+  }
+  //queries finish in order, so the last one written being available means all of them are
+  GLuint available = 0;
+  glGetQueryObjectuiv(frame.queries[frame.usedQueries - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+  if (!available)
+  {
+    dropped++;
+    return;
+  }
+  for (const Scope &scope : frame.scopes)
+  {
+    GLuint64 begin = 0;
+    GLuint64 end = 0;
+    glGetQueryObjectui64v(scope.begin, GL_QUERY_RESULT, &begin);
+    glGetQueryObjectui64v(scope.end, GL_QUERY_RESULT, &end);
+    Pass &pass = passes[scope.pass];
+    float ms = (float)((end - begin) / 1000000.0);
+    if (pass.samples.size() < samplesPerPass)
+    {
+      pass.samples.push_back(ms);
+    }
+    else
+    {
+      pass.samples[pass.next] = ms;
+    }
+    pass.next = (pass.next + 1) % samplesPerPass;
+  }
+}
+
+void GpuProfiler::beginFrame()
+{
+  current = (current + 1) % frames.size();
+  Frame &frame = frames[current];
+  //the oldest frame in the ring, queued frameLatency frames ago
+  if (frame.pending)
+  {
+    collect(frame);
+  }
+  frame.usedQueries = 0;
+  frame.scopes.clear();
+  open.clear();
+  inFrame = true;
+}
+
+void GpuProfiler::endFrame()
+{
+  //unbalanced scopes would leave a timestamp unwritten
+  while (!open.empty())
+  {
+    end();
+  }
+  frames[current].pending = !frames[current].scopes.empty();
+  inFrame = false;
+}
+
+void GpuProfiler::begin(const char *name)
+{
+  if (GLEXT_KHR_debug)
+  {
+    glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, name);
+  }
+  if (!inFrame)
+  {
+    open.push_back((size_t)-1);
+    return;
+  }
+  auto found = passByName.find(name);
+  uint32_t pass;
+  if (found == passByName.end())
+  {
+    pass = (uint32_t)passes.size();
+    passes.push_back({name, (int)open.size(), {}, 0});
+    passByName.emplace(name, pass);
+  }
+  else
+  {
+    pass = found->second;
+  }
+  Frame &frame = frames[current];
+  GLuint begin = query(frame);
+  glQueryCounter(begin, GL_TIMESTAMP);
+  open.push_back(frame.scopes.size());
+  frame.scopes.push_back({pass, begin, 0});
+}
+
+void GpuProfiler::end()
+{
+  if (open.empty())
+  {
+    return;
+  }
+  size_t scope = open.back();
+  open.pop_back();
+  if (scope != (size_t)-1)
+  {
+    Frame &frame = frames[current];
+    GLuint end = query(frame);
+    glQueryCounter(end, GL_TIMESTAMP);
+    frame.scopes[scope].end = end;
+  }
+  if (GLEXT_KHR_debug)
+  {
+    glPopDebugGroup();
+  }
+}
+
+std::vector<GpuProfiler::PassStats> GpuProfiler::report() const
+{
+  std::vector<PassStats> result;
+  std::vector<float> sorted;
+  for (const Pass &pass : passes)
+  {
+    PassStats stats;
+    stats.name = pass.name;
+    stats.depth = pass.depth;
+    stats.samples = pass.samples.size();
+    if (!pass.samples.empty())
+    {
+      sorted = pass.samples;
+      std::sort(sorted.begin(), sorted.end());
+      double total = 0.0;
+      for (float sample : sorted)
+      {
+        total += sample;
+      }
+      stats.minMs = sorted.front();
+      stats.avgMs = total / sorted.size();
+      stats.p50Ms = sorted[sorted.size() / 2];
+      stats.p99Ms = sorted[std::min(sorted.size() - 1, sorted.size() * 99 / 100)];
+    }
+    result.push_back(stats);
+  }
+  return result;
+}
+
+std::string GpuProfiler::format() const
+{
+  std::string text;
+  char line[256];
+  for (const PassStats &stats : report())
+  {
+    snprintf(line, sizeof(line), "%*s%-*s min %7.3f ms  avg %7.3f ms  p99 %7.3f ms  (%zu frames)\n",
+             stats.depth * 2, "", 24 - stats.depth * 2, stats.name.c_str(), stats.minMs, stats.avgMs, stats.p99Ms, stats.samples);
+    text += line;
+  }
+  return text;
+}
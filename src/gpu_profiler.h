@@ -0,0 +1,98 @@
+#pragma once
+#include "config.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+* Measures how long the GPU spends on each named pass without ever waiting for it.
+* Every scope writes a GL_TIMESTAMP query where it begins and ends
+* (timestamps rather than GL_TIME_ELAPSED, which cannot nest). Queries of
+* a frame go into one slot of a ring several frames deep and are only read
+* when the ring comes back around to that slot, by which time the GPU has
+* long finished them; if it has not, that frame's results are dropped
+* rather than waited for. With KHR_debug each scope is also a debug group,
+* so captures in RenderDoc or Nsight show the same names.
+* Each pass keeps its last samples for a rolling min / average / p99.
+*/
+class GpuProfiler
+{
+  public:
+    explicit GpuProfiler(unsigned int frameLatency = 4, size_t samplesPerPass = 240);
+    ~GpuProfiler();
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+    //brackets everything a frame sends to the GPU; beginFrame collects the oldest frame's results
+    void beginFrame();
+    void endFrame();
+    //scopes nest and must be closed in order within a frame; prefer GpuScope
+    void begin(const char *name);
+    void end();
+
+    struct PassStats
+    {
+      std::string name;
+      //nesting depth of the scope, for indenting reports
+      int depth = 0;
+      double minMs = 0.0;
+      double avgMs = 0.0;
+      double p50Ms = 0.0;
+      double p99Ms = 0.0;
+      size_t samples = 0;
+    };
+    //passes in the order they were first seen
+    std::vector<PassStats> report() const;
+    //one line per pass
+    std::string format() const;
+    //frames whose results were not ready when their slot came around
+    uint64_t droppedFrames() const { return dropped; }
+
+  private:
+    struct Scope
+    {
+      uint32_t pass;
+      GLuint begin;
+      GLuint end;
+    };
+    struct Frame
+    {
+      std::vector<GLuint> queries;
+      size_t usedQueries = 0;
+      std::vector<Scope> scopes;
+      bool pending = false;
+    };
+    struct Pass
+    {
+      std::string name;
+      int depth;
+      std::vector<float> samples;
+      size_t next = 0;
+    };
+
+    GLuint query(Frame &frame);
+    void collect(Frame &frame);
+
+    std::vector<Frame> frames;
+    size_t current = 0;
+    bool inFrame = false;
+    //indices into scopes of the current frame
+    std::vector<size_t> open;
+    std::vector<Pass> passes;
+    std::unordered_map<std::string, uint32_t> passByName;
+    size_t samplesPerPass;
+    uint64_t dropped = 0;
+};
+
+//times the rest of the enclosing block
+class GpuScope
+{
+  public:
+    GpuScope(GpuProfiler &profiler, const char *name) : profiler(profiler) { profiler.begin(name); }
+    ~GpuScope() { profiler.end(); }
+    GpuScope(const GpuScope&) = delete;
+    GpuScope& operator=(const GpuScope&) = delete;
+
+  private:
+    GpuProfiler &profiler;
+};
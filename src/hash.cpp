@@ -0,0 +1,36 @@
+#include "hash.h"
+#include <cstring>
+
+static inline uint64_t mix(uint64_t value)
+{
+  value ^= value >> 33;
+  value *= 0xff51afd7ed558ccdull;
+  value ^= value >> 33;
+  value *= 0xc4ceb9fe1a85ec53ull;
+  value ^= value >> 33;
+  return value;
+}
+
+uint64_t hashBytes(const void *data, size_t size, uint64_t seed)
+{
+  const unsigned char *bytes = (const unsigned char*)data;
+  //four independent lanes so the multiplies overlap
+  uint64_t lanes[4] = {seed ^ 0x9e3779b97f4a7c15ull, seed + FNV_PRIME, seed ^ FNV_OFFSET_BASIS, ~seed};
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32)
+  {
+    for (int lane = 0; lane < 4; lane++)
+    {
+      uint64_t word;
+      memcpy(&word, bytes + i + lane * 8, 8);
+      lanes[lane] = (lanes[lane] ^ word) * 0x9e3779b97f4a7c15ull;
+      lanes[lane] ^= lanes[lane] >> 31;
+    }
+  }
+  uint64_t hash = mix(lanes[0]) ^ mix(lanes[1] + 1) ^ mix(lanes[2] + 2) ^ mix(lanes[3] + 3);
+  for (; i < size; i++)
+  {
+    hash = (hash ^ bytes[i]) * FNV_PRIME;
+  }
+  return mix(hash ^ size);
+}
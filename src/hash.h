@@ -0,0 +1,19 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/*
+* Hashing helpers.
+* fnv1a64 is constexpr so short strings (uniform names, cache keys) can be
+* hashed at compile time; hashBytes is for bulk data such as file contents
+* and eats 32 bytes per step.
+*/
+constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+constexpr uint64_t fnv1a64(const char *text, uint64_t hash = FNV_OFFSET_BASIS)
+{
+  return *text ? fnv1a64(text + 1, (hash ^ (uint8_t)*text) * FNV_PRIME) : hash;
+}
+
+uint64_t hashBytes(const void *data, size_t size, uint64_t seed = 0);
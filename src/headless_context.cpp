@@ -0,0 +1,161 @@
+#include "headless_context.h"
+#include "gl_state.h"
+#include <cstdio>
+#include <cstring>
+#ifdef CALS_HAVE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+HeadlessContext::HeadlessContext(int width, int height) : framebufferWidth(width), framebufferHeight(height)
+{
+#ifdef CALS_HAVE_EGL
+  EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+  const char *clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+  if (clientExtensions && strstr(clientExtensions, "EGL_MESA_platform_surfaceless"))
+  {
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay)
+    {
+      eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    }
+  }
+  if (eglDisplay == EGL_NO_DISPLAY)
+  {
+    eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  }
+  EGLint major = 0;
+  EGLint minor = 0;
+  if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, &major, &minor))
+  {
+    printf("Failed to initialize EGL (0x%x)\n", eglGetError());
+    return;
+  }
+  display = eglDisplay;
+  const char *displayExtensions = eglQueryString(eglDisplay, EGL_EXTENSIONS);
+  if (!displayExtensions || !strstr(displayExtensions, "EGL_KHR_surfaceless_context"))
+  {
+    printf("EGL has no surfaceless contexts (EGL_KHR_surfaceless_context)\n");
+    return;
+  }
+  if (!eglBindAPI(EGL_OPENGL_API))
+  {
+    printf("EGL cannot create desktop GL contexts\n");
+    return;
+  }
+  const EGLint configAttributes[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+  EGLConfig config = NULL;
+  EGLint configs = 0;
+  eglChooseConfig(eglDisplay, configAttributes, &config, 1, &configs);
+  //the same 3.3 core profile the window asks GLFW for
+  const EGLint contextAttributes[] = {
+    EGL_CONTEXT_MAJOR_VERSION, 3,
+    EGL_CONTEXT_MINOR_VERSION, 3,
+    EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+    EGL_NONE
+  };
+  //without a matching config, EGL_KHR_no_config_context still allows one
+  EGLContext eglContext = eglCreateContext(eglDisplay, configs ? config : (EGLConfig)0, EGL_NO_CONTEXT, contextAttributes);
+  if (eglContext == EGL_NO_CONTEXT)
+  {
+    printf("Failed to create a GL 3.3 core context through EGL (0x%x)\n", eglGetError());
+    return;
+  }
+  if (!eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, eglContext))
+  {
+    printf("Failed to make the EGL context current (0x%x)\n", eglGetError());
+    eglDestroyContext(eglDisplay, eglContext);
+    return;
+  }
+  context = eglContext;
+#else
+  printf("Headless rendering needs EGL, which this build was configured without\n");
+#endif
+}
+
+HeadlessContext::~HeadlessContext()
+{
+#ifdef CALS_HAVE_EGL
+  if (context)
+  {
+    if (framebuffer)
+    {
+      glDeleteFramebuffers(1, &framebuffer);
+      glDeleteRenderbuffers(1, &colorBuffer);
+      glDeleteRenderbuffers(1, &depthBuffer);
+    }
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(display, context);
+  }
+  if (display)
+  {
+    eglTerminate(display);
+  }
+#endif
+}
+
+void *HeadlessContext::getProcAddress(const char *name)
+{
+#ifdef CALS_HAVE_EGL
+  return (void*)eglGetProcAddress(name);
+#else
+  return nullptr;
+#endif
+}
+
+bool HeadlessContext::createFramebuffer()
+{
+  glGenFramebuffers(1, &framebuffer);
+  glGenRenderbuffers(1, &colorBuffer);
+  glGenRenderbuffers(1, &depthBuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, framebufferWidth, framebufferHeight);
+  glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, framebufferWidth, framebufferHeight);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+  {
+    printf("Offscreen framebuffer is incomplete\n");
+    return false;
+  }
+  glViewport(0, 0, framebufferWidth, framebufferHeight);
+  return true;
+}
+
+void HeadlessContext::present()
+{
+  //nothing is shown, but like a swap this is where a frame's commands get flushed to the driver
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glFlush();
+}
+
+std::vector<unsigned char> HeadlessContext::readPixels() const
+{
+  std::vector<unsigned char> pixels((size_t)framebufferWidth * framebufferHeight * 4);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+  glState().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, framebufferWidth, framebufferHeight, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+  return pixels;
+}
+
+bool HeadlessContext::writeImage(const std::string &path) const
+{
+  std::vector<unsigned char> pixels = readPixels();
+  FILE *file = fopen(path.c_str(), "wb");
+  if (!file)
+  {
+    return false;
+  }
+  fprintf(file, "P6\n%d %d\n255\n", framebufferWidth, framebufferHeight);
+  for (int y = framebufferHeight - 1; y >= 0; y--)
+  {
+    for (int x = 0; x < framebufferWidth; x++)
+    {
+      fwrite(&pixels[((size_t)y * framebufferWidth + x) * 4], 1, 3, file);
+    }
+  }
+  return fclose(file) == 0;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include "config.h"
+#include <string>
+#include <vector>
+
+/*
+* A GL 3.3 core context without a window, for CI and machines with no GPU
+* or display. It comes from EGL, on Mesa's surfaceless platform when the
+* driver has it (llvmpipe renders on the CPU), otherwise the default
+* display, and is made current with no surface at all. Everything renders
+* into an offscreen framebuffer (RGBA8 color, 24-bit depth) that stays
+* bound as framebuffer 0 would be with a window.
+* Builds without EGL (CALS_HAVE_EGL unset) get a context that never opens.
+*/
+class HeadlessContext
+{
+  public:
+    HeadlessContext(int width, int height);
+    ~HeadlessContext();
+    HeadlessContext(const HeadlessContext&) = delete;
+    HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+    //false if no context could be made; the reason was printed
+    bool ok() const { return context != nullptr; }
+    //for gladLoadGLLoader and loadGLExtensions
+    static void *getProcAddress(const char *name);
+    //call once glad is loaded: creates the framebuffer and binds it
+    bool createFramebuffer();
+
+    //stands in for a buffer swap: rebinds the framebuffer and lets the driver run what was queued
+    void present();
+    int width() const { return framebufferWidth; }
+    int height() const { return framebufferHeight; }
+    //the last frame, rows bottom to top, RGBA
+    std::vector<unsigned char> readPixels() const;
+    //the last frame as a binary PPM (top row first), for image regression
+    bool writeImage(const std::string &path) const;
+
+  private:
+    int framebufferWidth;
+    int framebufferHeight;
+    void *display = nullptr;
+    void *context = nullptr;
+    GLuint framebuffer = 0;
+    GLuint colorBuffer = 0;
+    GLuint depthBuffer = 0;
+};
@@ -0,0 +1,118 @@
+#include "instanced_mesh.h"
+#include "gl_state.h"
+#include <cstddef>
+
+InstancedMesh::InstancedMesh(GLuint meshVertexArray, GLsizei indexCount, size_t capacity)
+  : indexCount(indexCount), capacity(capacity ? capacity : 1)
+{
+  //read the mesh's element buffer and per vertex attributes (0-2) back out of its vertex array
+  glState().bindVertexArray(meshVertexArray);
+  GLint elementBuffer = 0;
+  glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &elementBuffer);
+  struct VertexAttribute
+  {
+    GLint enabled, buffer, size, type, normalized, stride, integer;
+    void *pointer;
+  } meshAttributes[3];
+  for (GLuint attribute = 0; attribute < 3; attribute++)
+  {
+    VertexAttribute &info = meshAttributes[attribute];
+    glGetVertexAttribiv(attribute, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &info.enabled);
+    glGetVertexAttribiv(attribute, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &info.buffer);
+    glGetVertexAttribiv(attribute, GL_VERTEX_ATTRIB_ARRAY_SIZE, &info.size);
+    glGetVertexAttribiv(attribute, GL_VERTEX_ATTRIB_ARRAY_TYPE, &info.type);
+    glGetVertexAttribiv(attribute, GL_VERTEX_ATTRIB_ARRAY_NORMALIZED, &info.normalized);
+    glGetVertexAttribiv(attribute, GL_VERTEX_ATTRIB_ARRAY_STRIDE, &info.stride);
+    glGetVertexAttribiv(attribute, GL_VERTEX_ATTRIB_ARRAY_INTEGER, &info.integer);
+    glGetVertexAttribPointerv(attribute, GL_VERTEX_ATTRIB_ARRAY_POINTER, &info.pointer);
+  }
+
+  //the same buffers in a vertex array of our own, so the mesh's one never gets instance attributes
+  glGenVertexArrays(1, &vertexArray);
+  glState().bindVertexArray(vertexArray);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
+  for (GLuint attribute = 0; attribute < 3; attribute++)
+  {
+    const VertexAttribute &info = meshAttributes[attribute];
+    if (!info.enabled)
+    {
+      continue;
+    }
+    glState().bindBuffer(GL_ARRAY_BUFFER, info.buffer);
+    if (info.integer)
+    {
+      glVertexAttribIPointer(attribute, info.size, info.type, info.stride, info.pointer);
+    }
+    else
+    {
+      glVertexAttribPointer(attribute, info.size, info.type, info.normalized, info.stride, info.pointer);
+    }
+    glEnableVertexAttribArray(attribute);
+  }
+  glGenBuffers(1, &buffer);
+  glState().bindBuffer(GL_ARRAY_BUFFER, buffer);
+  glBufferData(GL_ARRAY_BUFFER, this->capacity * sizeof(MeshInstance), NULL, GL_STREAM_DRAW);
+  //attributes keep referring to this buffer, so growing it later needs no new pointers
+  const GLsizei stride = sizeof(MeshInstance);
+  glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(MeshInstance, position));
+  glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(MeshInstance, scale));
+  //integer attribute, glVertexAttribPointer would convert it to float
+  glVertexAttribIPointer(5, 1, GL_INT, stride, (void*)offsetof(MeshInstance, layer));
+  glVertexAttribPointer(6, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)offsetof(MeshInstance, color));
+  for (GLuint attribute = 3; attribute <= 6; attribute++)
+  {
+    glEnableVertexAttribArray(attribute);
+    glVertexAttribDivisor(attribute, 1);
+  }
+}
+
+InstancedMesh::~InstancedMesh()
+{
+  glState().deleteVertexArrays(1, &vertexArray);
+  glState().deleteBuffers(1, &buffer);
+}
+
+MeshInstance *InstancedMesh::add(size_t count)
+{
+  size_t first = instances.size();
+  instances.resize(first + count);
+  return instances.data() + first;
+}
+
+void InstancedMesh::upload()
+{
+  uploaded = (GLsizei)instances.size();
+  lastUploadBytes = instances.size() * sizeof(MeshInstance);
+  if (!uploaded)
+  {
+    return;
+  }
+  glState().bindBuffer(GL_ARRAY_BUFFER, buffer);
+  while (capacity < instances.size())
+  {
+    capacity *= 2;
+  }
+  //orphan first: the driver hands back new storage if the GPU still reads the old one
+  glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(MeshInstance), NULL, GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, lastUploadBytes, instances.data());
+}
+
+DrawItem InstancedMesh::drawItem() const
+{
+  DrawItem item;
+  item.vertexArray = vertexArray;
+  item.indexType = GL_UNSIGNED_INT;
+  item.count = indexCount;
+  item.instances = uploaded;
+  return item;
+}
+
+void InstancedMesh::draw() const
+{
+  if (!uploaded)
+  {
+    return;
+  }
+  glState().bindVertexArray(vertexArray);
+  glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0, uploaded);
+}
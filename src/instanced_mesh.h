@@ -0,0 +1,64 @@
+#pragma once
+#include "config.h"
+#include "render_queue.h"
+#include <vector>
+
+//one copy of the mesh, the per instance attributes of instanced.vs
+struct MeshInstance
+{
+  float position[3];
+  //radians, around the mesh origin
+  float rotation;
+  float scale[2];
+  //material array layer
+  int32_t layer;
+  //RGBA, multiplied with the material
+  uint8_t color[4];
+};
+
+/*
+* Draws any number of copies of one mesh with a single glDrawElementsInstanced.
+* Instances are collected on the CPU each frame, upload() writes them all
+* into one buffer (orphaned first, so it never waits on the GPU), and that
+* buffer feeds attributes 3-6 with a divisor of 1, so the vertex shader
+* sees a new MeshInstance for every copy. The cost on the CPU and in the
+* driver is one upload and one draw whether there are 1 or 1M instances.
+* The mesh's vertex array must already have its attributes (0-2) and
+* element buffer set up. They are copied into a vertex array the instanced
+* mesh owns, next to the instance attributes, and the mesh's one is left
+* as it was.
+*/
+class InstancedMesh
+{
+  public:
+    InstancedMesh(GLuint meshVertexArray, GLsizei indexCount, size_t capacity = 1024);
+    ~InstancedMesh();
+    InstancedMesh(const InstancedMesh&) = delete;
+    InstancedMesh& operator=(const InstancedMesh&) = delete;
+
+    void add(const MeshInstance &instance) { instances.push_back(instance); }
+    //room for count instances to be filled in place, valid until the next add
+    MeshInstance *add(size_t count);
+    //starts the next frame
+    void clear() { instances.clear(); }
+    size_t size() const { return instances.size(); }
+
+    //the one buffer write of the frame, grows the buffer when needed
+    void upload();
+    //every instance uploaded, for a RenderQueue (shader and texture are the caller's)
+    DrawItem drawItem() const;
+    //or straight away with whatever program and textures are bound
+    void draw() const;
+
+    //bytes written by the last upload()
+    size_t uploadedBytes() const { return lastUploadBytes; }
+
+  private:
+    GLuint vertexArray = 0;
+    GLsizei indexCount;
+    GLuint buffer = 0;
+    size_t capacity;
+    GLsizei uploaded = 0;
+    size_t lastUploadBytes = 0;
+    std::vector<MeshInstance> instances;
+};
@@ -1,6 +1,21 @@
 #include "config.h"
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
+#include "gl_ext.h"
+#include "texture_loader.h"
+#include "texture_array.h"
+#include "texture_cache.h"
+#include "shader_reload.h"
+#include "shader_permutations.h"
+#include "material_params.h"
+#include "shader_sources.h"
+#include "texture_upload.h"
+#include "command_recorder.h"
+#include "instanced_mesh.h"
+#include "quad_batcher.h"
+#include "fixed_timestep.h"
+#include "redraw_scheduler.h"
+#include "gpu_profiler.h"
+#include "cpu_profiler.h"
+#include "headless_context.h"
 void processInput (GLFWwindow *window);
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 /*
@@ -11,29 +26,70 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 */
 int main()
 {
- //create window, make sure glfw version >= 3.3
-  glfwInit();
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-  //create 800x600 window
-  GLFWwindow* window = glfwCreateWindow(800,600,"Hello, Window!", NULL, NULL);
-  if (window == NULL)
+  //CALS_TRACE=<file> records CPU zones and writes them there as a Chrome trace at exit
+  const char *tracePath = getenv("CALS_TRACE");
+  setCpuProfilerEnabled(tracePath != NULL);
+  setProfilerThreadName("main");
+  //textures baked by Cals_texc are just mapped, anything else starts decoding right away
+  //and finishes while the window and shaders are set up
+  //both images are flipped so (0,0) in texture coords is the bottom left like OpenGL expects
+  //all materials share one texture array, unbaked layers are resized and BC1 compressed while decoding
+  TextureDecodePool decodePool;
+  TextureArrayBuilder materials(1000, 1000, {BlockFormat::BC1, EncodeQuality::Normal});
+  int dirtLayer = materials.addLayer(decodePool, "textures/dirt.ctex", "../resources/textures/dirt.jpg");
+  int steveLayer = materials.addLayer(decodePool, "textures/steve.ctex", "../resources/textures/steve.jpg");
+  //CALS_HEADLESS=<frames> renders that many frames into an offscreen framebuffer without a window
+  //(CI, machines without a GPU), CALS_HEADLESS_IMAGE=<file.ppm> saves the last one
+  const char *headlessFrames = getenv("CALS_HEADLESS");
+  std::unique_ptr<HeadlessContext> headless;
+  GLFWwindow* window = NULL;
+  GLADloadproc loadProc;
+  if (headlessFrames)
   {
-    printf("Failed to open the GLFW window.");
-    glfwTerminate();
-    return -1;
+    headless.reset(new HeadlessContext(800, 600));
+    if (!headless->ok())
+    {
+      return -1;
+    }
+    loadProc = (GLADloadproc) HeadlessContext::getProcAddress;
+  }
+  else
+  {
+    //create window, make sure glfw version >= 3.3
+    {
+      CPU_ZONE("glfwInit");
+      glfwInit();
+    }
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    //create 800x600 window
+    {
+      CPU_ZONE("glfwCreateWindow");
+      window = glfwCreateWindow(800,600,"Hello, Window!", NULL, NULL);
+    }
+    if (window == NULL)
+    {
+      printf("Failed to open the GLFW window.");
+      glfwTerminate();
+      return -1;
+    }
+    glfwMakeContextCurrent(window);
+    //create view, and callback function which handles window resizing 
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback); 
+    loadProc = (GLADloadproc) glfwGetProcAddress;
   }
-  glfwMakeContextCurrent(window);
-  //create view, and callback function which handles window resizing 
-  glfwSetFramebufferSizeCallback(window, framebuffer_size_callback); 
   //load up glad
-  if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress))
+  if (!gladLoadGLLoader(loadProc))
   {
     printf("Failed to initialize GLAD");
     return -1;
   }
-  Shader ourShader("../src/shaders/shader.vs", "../src/shaders/shader.fs");
+  loadGLExtensions(loadProc);
+  if (headless && !headless->createFramebuffer())
+  {
+    return -1;
+  }
   /*create verticies for a simple triangle
   *               |(0,1)
   *               |
@@ -121,8 +177,8 @@ int main()
   glGenVertexArrays(1, &VAO);
   glGenBuffers(1, &EBO);
   //Bind it
-  glBindVertexArray(VAO);
-  glBindBuffer(GL_ARRAY_BUFFER, VBO);
+  glState().bindVertexArray(VAO);
+  glState().bindBuffer(GL_ARRAY_BUFFER, VBO);
   // any calls from now on effect our VBO
   // 0. copy verticies into buffer mem
   glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
@@ -146,90 +202,236 @@ int main()
   glVertexAttribPointer(2,2,GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*) (6 * sizeof(float)));
   glEnableVertexAttribArray(2);
 
-  //create texture
-  unsigned int texture1, texture2;
-  glGenTextures(1, &texture1);
-  glBindTexture(GL_TEXTURE_2D, texture1);
-  //texture parameters
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-  //glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  //glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_MIRRORED_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  int width, height, nrChannels;
-  stbi_set_flip_vertically_on_load(true);
-  unsigned char *data = stbi_load("../resources/textures/dirt.jpg", &width, &height, &nrChannels, 0);
-  if (data)
+  //everything owning GL objects lives in this block so it is destroyed while the context still exists
   {
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-  }
-  else
-  {
-    std::cout << "Texture load failed" << std::endl;
-  }
-  stbi_image_free(data);
-  glGenTextures(1, &texture2);
-  glBindTexture(GL_TEXTURE_2D, texture2);
-  //texture parameters
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-  //glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  //glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_MIRRORED_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    //shaders are compiled into the binary; dev builds (CALS_DEV_SHADERS) read src/shaders instead,
+    //and there edits to the files (or anything they include) are rebuilt and swapped in while running
+#ifdef CALS_DEV_SHADERS
+    setShaderSourceMode(ShaderSourceMode::Disk, CALS_SHADER_DIR);
+#endif
+    //the variant drawn here is only issued now, the driver compiles it while the textures upload
+    ShaderReloader shaderReloader;
+    ShaderPermutations materialShaders("shader.vs", "shader.fs",
+                                       {"OVERLAY", "VERTEX_COLOR", "SINGLE_TEXTURE"}, &shaderReloader);
+    materialShaders.prepare(MATERIAL_OVERLAY);
+    materialShaders.prepare(MATERIAL_VERTEX_COLOR);
+    materialShaders.prepare(MATERIAL_SINGLE_TEXTURE);
+    ShaderPermutations tileShaders("instanced.vs", "instanced.fs", {}, &shaderReloader);
+    tileShaders.prepare(0);
 
-  data = stbi_load("../resources/textures/steve.jpg", &width, &height, &nrChannels, 0);
-  if (data)
-  {
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-  }
-  else
-  {
-    std::cout << "Texture2 load failed" << std::endl;
-  }
+    //create textures, only the upload happens here; decoding ran on the pool
+    //pixels go through the PBO ring, wait for them once so the first frame is complete
+    //the cache owns every texture from here on and keeps them under a 256MB budget
+    TextureUploader uploader;
+    TextureCache textures(decodePool, uploader, 256 * 1024 * 1024);
+    size_t materialBytes = materials.sizeInBytes();
+    unsigned int builtMaterials = materials.build(uploader);
+    //nothing to adopt when the array could not be built, the materials then draw untextured
+    TextureHandle materialArray = builtMaterials ? textures.adopt(builtMaterials, materialBytes) : INVALID_TEXTURE_HANDLE;
+    uploader.finish();
+    //the picture in the corner is a plain GL_TEXTURE_2D loaded through the cache: hashed, counted
+    //against the budget and streamed in from its small mips while the first frames draw
+    TextureHandle picture = textures.load("textures/steve.ctex", "../resources/textures/steve.jpg");
 
+    Shader &ourShader = materialShaders.get(MATERIAL_OVERLAY);
+    ourShader.use();
+    ourShader.setInt("materials", 0);
+    ourShader.bindBlock("MaterialParams", MATERIAL_PARAMS_BINDING, sizeof(MaterialParams));
+    //every draw's parameters go into this buffer, written once per frame
+    UniformBlockBuffer<MaterialParams> materialBlocks;
+    //a row of tiles along the bottom, copies of the square drawn with one instanced call
+    Shader &tileShader = tileShaders.get(0);
+    tileShader.use();
+    tileShader.setInt("materials", 0);
+    InstancedMesh tiles(VAO, 6, 8);
+    //small colored quads orbiting the square, rebuilt every frame through the streaming batcher
+    Shader &sparkShader = materialShaders.get(MATERIAL_VERTEX_COLOR);
+    sparkShader.use();
+    sparkShader.setInt("materials", 0);
+    sparkShader.bindBlock("MaterialParams", MATERIAL_PARAMS_BINDING, sizeof(MaterialParams));
+    QuadBatcher sparks(1024);
+    Shader &pictureShader = materialShaders.get(MATERIAL_SINGLE_TEXTURE);
+    pictureShader.use();
+    pictureShader.setInt("materials", 0);
+    pictureShader.bindBlock("MaterialParams", MATERIAL_PARAMS_BINDING, sizeof(MaterialParams));
+    //simulation steps at 120Hz whatever the refresh rate, frames draw in between two ticks
+    FixedTimestep simulation(1.0 / 120.0);
+    float sparkAngle = 0.0f;
+    float previousSparkAngle = 0.0f;
+    //draws are recorded with a sort key and issued together, grouped by shader, material and mesh
+    //each part of the scene is its own region, recorded on the pool in parallel and only replayed here
+    RenderQueue renderQueue;
+    ThreadPool recordPool;
+    CommandRecorder recorder(recordPool);
+    enum { PASS_OPAQUE, PASS_TRANSPARENT };
+    enum { REGION_SQUARE, REGION_TILES, REGION_COUNT };
+    //frames are only drawn when something changed; space pauses the orbit, and with nothing
+    //moving the loop sleeps until the next input, resize or shader reload
+    RedrawScheduler redraw(window);
+    bool sparksPaused = false;
+    bool spaceWasDown = false;
+    //GPU time of each pass, read back a few frames late so it never stalls; printed at exit
+    GpuProfiler gpuProfiler;
 
-  ourShader.use();
-  glUniform1i(glGetUniformLocation(ourShader.ID, "texture1"), 0);
-  ourShader.setInt("texture2", 1);
+    //headless runs a fixed number of frames on a fixed clock, so the output is the same every run
+    long frameLimit = headless ? atol(headlessFrames) : 0;
+    long framesDrawn = 0;
 
-  //rendering loop!
-  while (!glfwWindowShouldClose(window))
-  {
-    //input
-    processInput(window);
-    //rendering
-    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
-    // float timeValue = glfwGetTime();
-    // float greenValue = sin(timeValue) / 2.0f + 0.5f;
-    // int vertexColorLocation = glGetUniformLocation(shaderProgram, "ourColor");
-    // glUniform4f(vertexColorLocation, 0.0f, greenValue, 0.0f, 1.0f);
-    //ourShader.setFloat("aPos", 1.0f);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture1);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, texture2);
-    glBindVertexArray(VAO);
-    //one triangle
-    //glDrawArrays(GL_TRIANGLES, 0,3);
-    //square
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-    //polygon mode (apply to front and back of all triangles, draw as lines)
-    //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-    //to turn off polygon:
-    //glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-    //call events, swap buffers
-    glfwSwapBuffers(window);
-    glfwPollEvents();
+    //rendering loop!
+    while (headless ? framesDrawn < frameLimit : !glfwWindowShouldClose(window))
+    {
+      CPU_ZONE("frame");
+      double now = headless ? framesDrawn / 60.0 : glfwGetTime();
+      //input
+      if (window)
+      {
+        processInput(window);
+        bool spaceDown = glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS;
+        if (spaceDown && !spaceWasDown)
+        {
+          sparksPaused = !sparksPaused;
+        }
+        spaceWasDown = spaceDown;
+      }
+      for (int steps = simulation.advance(now); steps > 0; steps--)
+      {
+        previousSparkAngle = sparkAngle;
+        sparkAngle += sparksPaused ? 0.0f : 0.5f * (float)simulation.tick();
+      }
+      if (!sparksPaused)
+      {
+        redraw.animate();
+      }
+      //anything queued later streams in a few MB per frame instead of stalling
+      uploader.update(8 * 1024 * 1024);
+      textures.update();
+      //finer mips only stream in for textures being drawn, so keep drawing until they are all there
+      bool texturesChanging = textures.loadingCount() || textures.refiningCount();
+      if (shaderReloader.update() || shaderReloader.busy() || !uploader.idle() || texturesChanging)
+      {
+        redraw.request();
+      }
+      if (!redraw.shouldDraw(now))
+      {
+        redraw.waitEvents();
+        continue;
+      }
+      //rendering, binds go through the state cache so the ones that change nothing are dropped
+      gpuProfiler.beginFrame();
+      gpuProfiler.begin("clear");
+      glState().clearColor(0.2f, 0.3f, 0.3f, 1.0f);
+      glClear(GL_COLOR_BUFFER_BIT);
+      gpuProfiler.end();
+      // float timeValue = glfwGetTime();
+      // float greenValue = sin(timeValue) / 2.0f + 0.5f;
+      // int vertexColorLocation = glGetUniformLocation(shaderProgram, "ourColor");
+      // glUniform4f(vertexColorLocation, 0.0f, greenValue, 0.0f, 1.0f);
+      //ourShader.setFloat("aPos", 1.0f);
+      materialBlocks.clear();
+      uint32_t squareMaterial = materialBlocks.push({dirtLayer, steveLayer, 0.5f, 0.0f, {1.0f, 1.0f, 1.0f, 1.0f}});
+      uint32_t sparkMaterial = materialBlocks.push({dirtLayer, dirtLayer, 0.0f, 0.0f, {1.0f, 1.0f, 1.0f, 1.0f}});
+      materialBlocks.upload();
+      //every material lives in this one texture array
+      //anything not thread safe (the texture cache) is resolved before recording starts
+      GLuint materialTexture = materialArray != INVALID_TEXTURE_HANDLE ? textures.acquire(materialArray) : 0;
+      UniformRange squareUniforms = materialBlocks.range(squareMaterial);
+      tiles.clear();
+      for (int i = 0; i < 8; i++)
+      {
+        tiles.add({{-0.875f + i * 0.25f, -0.85f, 0.0f}, 0.0f, {0.2f, 0.2f}, i % 2 ? steveLayer : dirtLayer, {255, 255, 255, 255}});
+      }
+      tiles.upload();
+      recorder.record(REGION_COUNT, [&](CommandList &list, size_t region)
+      {
+        if (region == REGION_SQUARE)
+        {
+          DrawItem square;
+          square.shader = &ourShader;
+          square.vertexArray = VAO;
+          square.textureTarget = GL_TEXTURE_2D_ARRAY;
+          square.texture = materialTexture;
+          square.uniformBinding = MATERIAL_PARAMS_BINDING;
+          square.uniforms = squareUniforms;
+          square.indexType = GL_UNSIGNED_INT;
+          square.count = 6;
+          list.submit(sortkey::make(PASS_OPAQUE, 0, 0, 0, 0), square);
+        }
+        else if (region == REGION_TILES)
+        {
+          DrawItem tileRow = tiles.drawItem();
+          tileRow.shader = &tileShader;
+          tileRow.textureTarget = GL_TEXTURE_2D_ARRAY;
+          tileRow.texture = materialTexture;
+          list.submit(sortkey::make(PASS_OPAQUE, 1, 0, 0, 0), tileRow);
+        }
+      }, renderQueue);
+      gpuProfiler.begin("scene");
+      renderQueue.execute();
+      gpuProfiler.end();
+      gpuProfiler.begin("sparks");
+      sparkShader.use();
+      materialBlocks.bind(MATERIAL_PARAMS_BINDING, sparkMaterial);
+      sparks.begin();
+      float orbit = previousSparkAngle + (sparkAngle - previousSparkAngle) * simulation.alpha();
+      for (int i = 0; i < 64; i++)
+      {
+        float angle = orbit + i * (6.2831853f / 64.0f);
+        float x = cosf(angle) * 0.7f;
+        float y = sinf(angle) * 0.7f + 0.1f;
+        sparks.quad(x - 0.02f, y - 0.02f, x + 0.02f, y + 0.02f, 0.0f, 0.5f + 0.5f * cosf(angle), 0.5f + 0.5f * sinf(angle), 1.0f);
+      }
+      sparks.flush();
+      gpuProfiler.end();
+      //same batcher and material, only the shader and texture change; nothing to draw until the load lands
+      gpuProfiler.begin("picture");
+      GLuint pictureTexture = textures.acquire(picture);
+      if (pictureTexture)
+      {
+        pictureShader.use();
+        glState().bindTextureUnit(0, GL_TEXTURE_2D, pictureTexture);
+        sparks.quad(0.6f, 0.6f, 0.95f, 0.95f, 0.0f, 1.0f, 1.0f, 1.0f);
+      }
+      sparks.end();
+      gpuProfiler.end();
+      gpuProfiler.endFrame();
+      //one triangle
+      //glDrawArrays(GL_TRIANGLES, 0,3);
+      //polygon mode (apply to front and back of all triangles, draw as lines)
+      //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+      //to turn off polygon:
+      //glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+      //call events, swap buffers
+      if (headless)
+      {
+        headless->present();
+      }
+      else
+      {
+        CPU_ZONE("glfwSwapBuffers");
+        glfwSwapBuffers(window);
+      }
+      framesDrawn++;
+      redraw.drawn(now);
+      redraw.waitEvents();
+    }
+    std::cout << "Frames: " << redraw.stats().drawn << " drawn, " << redraw.stats().skipped << " skipped" << std::endl;
+    std::cout << "GPU passes:" << std::endl << gpuProfiler.format();
+    const char *imagePath = getenv("CALS_HEADLESS_IMAGE");
+    if (headless && imagePath && headless->writeImage(imagePath))
+    {
+      std::cout << "Last frame written to " << imagePath << std::endl;
+    }
+    if (tracePath && writeChromeTrace(tracePath))
+    {
+      std::cout << "CPU trace written to " << tracePath << std::endl;
+    }
+    const GLStateCache::Counters &stateCalls = glState().counters();
+    std::cout << "GL state calls: " << stateCalls.issued << " issued, " << stateCalls.elided << " elided" << std::endl;
+    //delete resources when done
+    glState().deleteVertexArrays(1, &VAO);
+    glState().deleteBuffers(1, &VBO);
+    //glDeleteBuffers(1, &EBO);
   }
-  //delete resources when done
-  glDeleteVertexArrays(1, &VAO);
-  glDeleteBuffers(1, &VBO);
-  //glDeleteBuffers(1, &EBO);
   glfwTerminate();
   return 0;
 }
@@ -0,0 +1,24 @@
+#pragma once
+#include "uniform_buffer.h"
+
+//feature bits of the material shader, each one an #ifdef block in shader.fs (or materials.glsl)
+enum MaterialFeature : uint32_t
+{
+  MATERIAL_OVERLAY = 1 << 0,
+  MATERIAL_VERTEX_COLOR = 1 << 1,
+  MATERIAL_SINGLE_TEXTURE = 1 << 2,
+};
+//per draw material parameters, the MaterialParams block in shader.fs
+struct MaterialParams
+{
+  int32_t baseLayer;
+  int32_t overlayLayer;
+  float overlayMix;
+  float padding;
+  std140::vec4 tint;
+};
+STD140_MEMBER(MaterialParams, baseLayer);
+STD140_MEMBER(MaterialParams, overlayLayer);
+STD140_MEMBER(MaterialParams, overlayMix);
+STD140_MEMBER(MaterialParams, tint);
+const GLuint MATERIAL_PARAMS_BINDING = 0;
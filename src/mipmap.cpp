@@ -0,0 +1,74 @@
+#include "mipmap.h"
+#include <algorithm>
+#include <cmath>
+
+MipLevel downsampleLevel(const unsigned char *pixels, int width, int height, int channels)
+{
+  MipLevel level;
+  level.width = std::max(1, width / 2);
+  level.height = std::max(1, height / 2);
+  level.pixels.resize((size_t)level.width * level.height * channels);
+  for (int y = 0; y < level.height; y++)
+  {
+    //odd sizes and 1 pixel wide/tall levels reuse the last row/column
+    int y0 = std::min(y * 2, height - 1);
+    int y1 = std::min(y * 2 + 1, height - 1);
+    for (int x = 0; x < level.width; x++)
+    {
+      int x0 = std::min(x * 2, width - 1);
+      int x1 = std::min(x * 2 + 1, width - 1);
+      for (int c = 0; c < channels; c++)
+      {
+        int sum = pixels[((size_t)y0 * width + x0) * channels + c] + pixels[((size_t)y0 * width + x1) * channels + c]
+                + pixels[((size_t)y1 * width + x0) * channels + c] + pixels[((size_t)y1 * width + x1) * channels + c];
+        level.pixels[((size_t)y * level.width + x) * channels + c] = (unsigned char)((sum + 2) / 4);
+      }
+    }
+  }
+  return level;
+}
+
+std::vector<MipLevel> buildMipChain(const unsigned char *pixels, int width, int height, int channels)
+{
+  std::vector<MipLevel> chain;
+  while (width > 1 || height > 1)
+  {
+    chain.push_back(downsampleLevel(pixels, width, height, channels));
+    pixels = chain.back().pixels.data();
+    width = chain.back().width;
+    height = chain.back().height;
+  }
+  return chain;
+}
+
+MipLevel resizeImage(const unsigned char *pixels, int width, int height, int channels, int newWidth, int newHeight)
+{
+  MipLevel level;
+  level.width = newWidth;
+  level.height = newHeight;
+  level.pixels.resize((size_t)newWidth * newHeight * channels);
+  float scaleX = (float)width / newWidth;
+  float scaleY = (float)height / newHeight;
+  for (int y = 0; y < newHeight; y++)
+  {
+    //sample at pixel centres so edges do not shift
+    float sourceY = std::min(std::max((y + 0.5f) * scaleY - 0.5f, 0.0f), (float)(height - 1));
+    int y0 = (int)sourceY;
+    int y1 = std::min(y0 + 1, height - 1);
+    float fy = sourceY - y0;
+    for (int x = 0; x < newWidth; x++)
+    {
+      float sourceX = std::min(std::max((x + 0.5f) * scaleX - 0.5f, 0.0f), (float)(width - 1));
+      int x0 = (int)sourceX;
+      int x1 = std::min(x0 + 1, width - 1);
+      float fx = sourceX - x0;
+      for (int c = 0; c < channels; c++)
+      {
+        float top = pixels[((size_t)y0 * width + x0) * channels + c] * (1 - fx) + pixels[((size_t)y0 * width + x1) * channels + c] * fx;
+        float bottom = pixels[((size_t)y1 * width + x0) * channels + c] * (1 - fx) + pixels[((size_t)y1 * width + x1) * channels + c] * fx;
+        level.pixels[((size_t)y * newWidth + x) * channels + c] = (unsigned char)std::lround(top * (1 - fy) + bottom * fy);
+      }
+    }
+  }
+  return level;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <vector>
+
+/*
+* CPU side mip chain generation and resizing for 8 bit images.
+* Uses the same 2x2 box filter on the stored values that glGenerateMipmap
+* uses on typical drivers, so baked and GPU generated chains look alike.
+*/
+struct MipLevel
+{
+  int width = 0;
+  int height = 0;
+  std::vector<unsigned char> pixels;
+};
+
+//halves an image (never below 1x1), rows tightly packed
+MipLevel downsampleLevel(const unsigned char *pixels, int width, int height, int channels);
+//every level after the base one, down to 1x1
+std::vector<MipLevel> buildMipChain(const unsigned char *pixels, int width, int height, int channels);
+//bilinear resize to any size, used to bring texture array layers to a common size
+MipLevel resizeImage(const unsigned char *pixels, int width, int height, int channels, int newWidth, int newHeight);
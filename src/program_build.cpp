@@ -0,0 +1,152 @@
+#include "program_build.h"
+#include "program_cache.h"
+#include "shader_preprocessor.h"
+#include "gl_ext.h"
+#include "cpu_profiler.h"
+
+static bool compiled(GLuint shader, const std::string &name, const char *stage)
+{
+  GLint success = 0;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+  if (!success)
+  {
+    char infoLog[512];
+    glGetShaderInfoLog(shader, sizeof(infoLog), NULL, infoLog);
+    std::cout << "ERROR::SHADER::" << stage << "_COMPILATION_FAILED " << name << "\n" << infoLog << std::endl;
+  }
+  return success != 0;
+}
+
+static GLuint issueCompile(GLenum stage, const std::string &source)
+{
+  const char *code = source.c_str();
+  GLuint shader = glCreateShader(stage);
+  glShaderSource(shader, 1, &code, NULL);
+  glCompileShader(shader);
+  return shader;
+}
+
+ProgramBuild beginProgramBuild(const std::string &vertexSource, const std::string &fragmentSource, const std::string &name)
+{
+  static bool threadsRequested = false;
+  if (GLEXT_KHR_parallel_shader_compile && !threadsRequested)
+  {
+    //the default is implementation defined (sometimes none), ask for as many as the driver allows
+    glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    threadsRequested = true;
+  }
+
+  CPU_ZONE("beginProgramBuild");
+  ProgramBuild build;
+  build.name = name;
+  build.program = glCreateProgram();
+  build.cacheKey = programCacheKey(vertexSource, fragmentSource);
+  if (loadProgramBinary(build.program, build.cacheKey))
+  {
+    return build;
+  }
+  build.vertex = issueCompile(GL_VERTEX_SHADER, vertexSource);
+  build.fragment = issueCompile(GL_FRAGMENT_SHADER, fragmentSource);
+  //linking straight away is fine, a failed compile just makes the link fail too
+  glAttachShader(build.program, build.vertex);
+  glAttachShader(build.program, build.fragment);
+  prepareProgramBinary(build.program);
+  glLinkProgram(build.program);
+  return build;
+}
+
+bool programBuildReady(const ProgramBuild &build)
+{
+  if (!build.vertex || !GLEXT_KHR_parallel_shader_compile)
+  {
+    return true;
+  }
+  GLint done = 0;
+  glGetProgramiv(build.program, GL_COMPLETION_STATUS_KHR, &done);
+  return done != 0;
+}
+
+GLuint finishProgramBuild(ProgramBuild &build)
+{
+  CPU_ZONE("finishProgramBuild");
+  if (!build.vertex)
+  {
+    return build.program;
+  }
+  bool ok = compiled(build.vertex, build.name, "VERTEX");
+  ok = compiled(build.fragment, build.name, "FRAGMENT") && ok;
+  GLint linked = 0;
+  glGetProgramiv(build.program, GL_LINK_STATUS, &linked);
+  if (ok && !linked)
+  {
+    char infoLog[512];
+    glGetProgramInfoLog(build.program, sizeof(infoLog), NULL, infoLog);
+    std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED " << build.name << "\n" << infoLog << std::endl;
+  }
+  glDetachShader(build.program, build.vertex);
+  glDetachShader(build.program, build.fragment);
+  glDeleteShader(build.vertex);
+  glDeleteShader(build.fragment);
+  build.vertex = build.fragment = 0;
+  if (!linked)
+  {
+    glDeleteProgram(build.program);
+    build.program = 0;
+    return 0;
+  }
+  storeProgramBinary(build.program, build.cacheKey);
+  return build.program;
+}
+
+bool readShaderFile(const char *path, std::string &source)
+{
+  std::ifstream file(path, std::ios::binary);
+  if (!file)
+  {
+    std::cout << "ERROR::SHADER::READING_FILE_FAILED " << path << std::endl;
+    return false;
+  }
+  std::stringstream stream;
+  stream << file.rdbuf();
+  source = stream.str();
+  return true;
+}
+
+size_t ProgramBatch::add(const char *vertexPath, const char *fragmentPath, const std::string &defines)
+{
+  //an unreadable file compiles as an empty shader and fails with a log like any other error
+  PreprocessedShader vertex;
+  PreprocessedShader fragment;
+  preprocessShader(vertexPath, defines, vertex);
+  preprocessShader(fragmentPath, defines, fragment);
+  return addSource(vertex.code, fragment.code, std::string(vertexPath) + " + " + fragmentPath);
+}
+
+size_t ProgramBatch::addSource(const std::string &vertexSource, const std::string &fragmentSource, const std::string &name)
+{
+  builds.push_back(beginProgramBuild(vertexSource, fragmentSource, name));
+  return builds.size() - 1;
+}
+
+bool ProgramBatch::ready() const
+{
+  for (const ProgramBuild &build : builds)
+  {
+    if (!programBuildReady(build))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::vector<GLuint> ProgramBatch::finish()
+{
+  std::vector<GLuint> programs;
+  for (ProgramBuild &build : builds)
+  {
+    programs.push_back(finishProgramBuild(build));
+  }
+  builds.clear();
+  return programs;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+* Program builds split in two halves so the driver never has to finish one
+* before the next is issued. Every glGetShaderiv / glGetProgramiv status
+* query waits for the compile or link it asks about, so beginProgramBuild
+* only issues work and finishProgramBuild does all the checking.
+* With KHR_parallel_shader_compile the driver compiles on its own threads
+* and programBuildReady polls without waiting; without it the status is
+* only known by waiting, and programBuildReady always says yes.
+* Programs in the binary cache (program_cache.h) are linked from it instead.
+* Only plain headers here: dependencies/shader.h includes this from inside config.h.
+*/
+struct ProgramBuild
+{
+  std::string name; //for error messages
+  GLuint program = 0;
+  //0 when the program came from the binary cache
+  GLuint vertex = 0;
+  GLuint fragment = 0;
+  uint64_t cacheKey = 0;
+};
+
+ProgramBuild beginProgramBuild(const std::string &vertexSource, const std::string &fragmentSource, const std::string &name = "");
+//never waits, true once finishProgramBuild will not have to
+bool programBuildReady(const ProgramBuild &build);
+//checks and logs every status, caches the binary; returns the program, or 0 (and deletes it) on failure
+GLuint finishProgramBuild(ProgramBuild &build);
+
+//false and logs if the file cannot be read
+bool readShaderFile(const char *path, std::string &source);
+
+/*
+* Builds many programs at once: add() everything, do other work (texture
+* decodes, buffer setup), then finish(). Compiles overlap on drivers with
+* parallel compilation and never wait on each other anywhere else.
+*/
+class ProgramBatch
+{
+  public:
+    //both return the index of the program in finish()'s result
+    //shader names (shader_sources.h) go through the preprocessor (#include, defines after #version)
+    size_t add(const char *vertexPath, const char *fragmentPath, const std::string &defines = "");
+    size_t addSource(const std::string &vertexSource, const std::string &fragmentSource, const std::string &name = "");
+
+    //true once every program is done compiling, never waits
+    bool ready() const;
+    //finishes every build, waiting only for those still running; 0 for programs that failed
+    std::vector<GLuint> finish();
+
+  private:
+    std::vector<ProgramBuild> builds;
+};
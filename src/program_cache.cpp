@@ -0,0 +1,143 @@
+#include "program_cache.h"
+#include "gl_ext.h"
+#include "hash.h"
+#include <cstdio>
+#include <vector>
+#include <sys/stat.h>
+
+static const uint32_t PROGRAM_CACHE_MAGIC = 0x47525043; //"CPRG"
+static const uint32_t PROGRAM_CACHE_VERSION = 1;
+
+struct ProgramCacheHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t binaryFormat; //GL enum from glGetProgramBinary
+  uint32_t length;
+  uint64_t key; //guards against a hash collision on the file name
+};
+
+static std::string cacheDirectory = "shader_cache";
+
+void setProgramCacheDirectory(const std::string &path)
+{
+  cacheDirectory = path;
+}
+
+static std::string cachePath(uint64_t key)
+{
+  char name[32];
+  snprintf(name, sizeof(name), "/%016llx.bin", (unsigned long long)key);
+  return cacheDirectory + name;
+}
+
+static std::string driverString(GLenum name)
+{
+  const char *value = (const char*)glGetString(name);
+  return value ? value : "";
+}
+
+uint64_t programCacheKey(const std::string &vertexSource, const std::string &fragmentSource)
+{
+  //lengths go in too so moving text from one stage to the other changes the key
+  std::string driver = driverString(GL_VENDOR) + "\n" + driverString(GL_RENDERER) + "\n" + driverString(GL_VERSION);
+  uint64_t key = fnv1a64(driver.c_str());
+  for (const std::string *part : {&vertexSource, &fragmentSource})
+  {
+    uint64_t length = part->size();
+    key = hashBytes(&length, sizeof(length), key);
+    key = hashBytes(part->data(), part->size(), key);
+  }
+  return key;
+}
+
+bool loadProgramBinary(GLuint program, uint64_t key)
+{
+  if (!GLEXT_ARB_get_program_binary)
+  {
+    return false;
+  }
+  std::string path = cachePath(key);
+  FILE *file = fopen(path.c_str(), "rb");
+  if (!file)
+  {
+    return false;
+  }
+  //a truncated or damaged file must not make us read (or allocate) past its end
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  ProgramCacheHeader header;
+  std::vector<char> binary;
+  bool valid = fread(&header, sizeof(header), 1, file) == 1 && header.magic == PROGRAM_CACHE_MAGIC
+            && header.version == PROGRAM_CACHE_VERSION && header.key == key
+            && size >= (long)sizeof(header) && (uint64_t)size - sizeof(header) == header.length;
+  if (valid)
+  {
+    binary.resize(header.length);
+    valid = fread(binary.data(), 1, binary.size(), file) == binary.size();
+  }
+  fclose(file);
+
+  GLint linked = 0;
+  if (valid)
+  {
+    glProgramBinary(program, header.binaryFormat, binary.data(), (GLsizei)binary.size());
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+  }
+  if (!linked)
+  {
+    //rejected or damaged, drop it so the fresh binary from the source build replaces it
+    std::cout << "Program binary cache: discarding " << path << std::endl;
+    remove(path.c_str());
+    return false;
+  }
+  return true;
+}
+
+void prepareProgramBinary(GLuint program)
+{
+  if (GLEXT_ARB_get_program_binary)
+  {
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
+}
+
+void storeProgramBinary(GLuint program, uint64_t key)
+{
+  if (!GLEXT_ARB_get_program_binary)
+  {
+    return;
+  }
+  GLint length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0)
+  {
+    return;
+  }
+  ProgramCacheHeader header = {PROGRAM_CACHE_MAGIC, PROGRAM_CACHE_VERSION, 0, 0, key};
+  std::vector<char> binary(length);
+  GLsizei written = 0;
+  GLenum binaryFormat = 0;
+  glGetProgramBinary(program, length, &written, &binaryFormat, binary.data());
+  header.binaryFormat = binaryFormat;
+  header.length = (uint32_t)written;
+
+  //written under a temporary name and renamed, so a crash never leaves half a binary behind
+  mkdir(cacheDirectory.c_str(), 0755);
+  std::string path = cachePath(key);
+  std::string temporary = path + ".tmp";
+  FILE *file = fopen(temporary.c_str(), "wb");
+  if (!file)
+  {
+    std::cout << "Program binary cache: cannot write " << temporary << std::endl;
+    return;
+  }
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(binary.data(), 1, written, file) == (size_t)written;
+  ok = fclose(file) == 0 && ok;
+  if (!ok || rename(temporary.c_str(), path.c_str()) != 0)
+  {
+    std::cout << "Program binary cache: cannot write " << path << std::endl;
+    remove(temporary.c_str());
+  }
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstdint>
+#include <string>
+
+/*
+* On-disk cache of linked program binaries (GL 4.1 / ARB_get_program_binary).
+* Entries are keyed by programCacheKey: a hash of the sources (permutation
+* defines are already spliced into them) and the driver's vendor, renderer and
+* version strings, so an edited shader or a new driver simply misses instead
+* of loading a stale binary.
+* A driver can still reject a binary it wrote itself, callers then compile
+* from source as if nothing was cached.
+* Only plain headers here: dependencies/shader.h includes this from inside config.h.
+*/
+
+//needs a current context for the driver strings
+uint64_t programCacheKey(const std::string &vertexSource, const std::string &fragmentSource);
+
+//links program from the cached binary, false if there is none or the driver rejected it
+bool loadProgramBinary(GLuint program, uint64_t key);
+//call before glLinkProgram so the driver keeps a binary it can hand back
+void prepareProgramBinary(GLuint program);
+//saves a successfully linked program, does nothing without driver support
+void storeProgramBinary(GLuint program, uint64_t key);
+
+//"shader_cache" in the working directory unless changed, created on the first store
+void setProgramCacheDirectory(const std::string &path);
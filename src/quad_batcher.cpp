@@ -0,0 +1,153 @@
+#include "quad_batcher.h"
+#include "gl_state.h"
+#include "gl_ext.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+QuadBatcher::QuadBatcher(size_t maxQuads) : maxQuads(maxQuads ? maxQuads : 1)
+{
+  glGenVertexArrays(1, &vertexArray);
+  glGenBuffers(1, &vertexBuffer);
+  glGenBuffers(1, &elementBuffer);
+  glState().bindVertexArray(vertexArray);
+  glState().bindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+  size_t regionBytes = this->maxQuads * 4 * sizeof(BatchVertex);
+  if (GLEXT_ARB_buffer_storage)
+  {
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage(GL_ARRAY_BUFFER, regionBytes * REGIONS, NULL, flags);
+    mapped = (BatchVertex*)glMapBufferRange(GL_ARRAY_BUFFER, 0, regionBytes * REGIONS, flags);
+  }
+  else
+  {
+    glBufferData(GL_ARRAY_BUFFER, regionBytes, NULL, GL_STREAM_DRAW);
+    staging.resize(this->maxQuads * 4);
+  }
+  //the same two triangles for every quad, the base vertex of each draw picks where they start
+  std::vector<GLuint> indices(this->maxQuads * 6);
+  for (size_t i = 0; i < this->maxQuads; i++)
+  {
+    GLuint first = (GLuint)(i * 4);
+    GLuint quadIndices[] = {first, first + 1, first + 3, first + 1, first + 2, first + 3};
+    std::copy(quadIndices, quadIndices + 6, indices.begin() + i * 6);
+  }
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+  const GLsizei stride = sizeof(BatchVertex);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(BatchVertex, position));
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(BatchVertex, color));
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(BatchVertex, texCoord));
+  glEnableVertexAttribArray(2);
+}
+
+QuadBatcher::~QuadBatcher()
+{
+  for (GLsync &fence : fences)
+  {
+    if (fence)
+    {
+      glDeleteSync(fence);
+    }
+  }
+  if (mapped)
+  {
+    glState().bindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+  }
+  glState().deleteBuffers(1, &vertexBuffer);
+  glState().deleteBuffers(1, &elementBuffer);
+  glState().deleteVertexArrays(1, &vertexArray);
+}
+
+void QuadBatcher::begin()
+{
+  written = 0;
+  drawn = 0;
+  if (!mapped)
+  {
+    //orphan: the driver hands back new storage if the GPU still reads last frame's
+    glState().bindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, maxQuads * 4 * sizeof(BatchVertex), NULL, GL_STREAM_DRAW);
+    return;
+  }
+  GLsync &fence = fences[region];
+  if (!fence)
+  {
+    return;
+  }
+  GLenum result = glClientWaitSync(fence, 0, 0);
+  if (result == GL_TIMEOUT_EXPIRED)
+  {
+    counters.waits++;
+    while (result == GL_TIMEOUT_EXPIRED)
+    {
+      result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+    }
+  }
+  glDeleteSync(fence);
+  fence = 0;
+}
+
+BatchVertex *QuadBatcher::quad()
+{
+  if (written == maxQuads)
+  {
+    end();
+    begin();
+  }
+  counters.quads++;
+  size_t first = written++ * 4;
+  return mapped ? mapped + region * maxQuads * 4 + first : staging.data() + first;
+}
+
+void QuadBatcher::quad(float x0, float y0, float x1, float y1, float z, float r, float g, float b)
+{
+  BatchVertex *corners = quad();
+  corners[0] = {{x1, y1, z}, {r, g, b}, {1.0f, 1.0f}};
+  corners[1] = {{x1, y0, z}, {r, g, b}, {1.0f, 0.0f}};
+  corners[2] = {{x0, y0, z}, {r, g, b}, {0.0f, 0.0f}};
+  corners[3] = {{x0, y1, z}, {r, g, b}, {0.0f, 1.0f}};
+}
+
+void QuadBatcher::flush()
+{
+  if (drawn == written)
+  {
+    return;
+  }
+  size_t quads = written - drawn;
+  size_t bytes = quads * 4 * sizeof(BatchVertex);
+  GLint baseVertex = (GLint)(drawn * 4);
+  if (mapped)
+  {
+    //coherent mapping, the writes are already visible to the GPU
+    baseVertex += (GLint)(region * maxQuads * 4);
+  }
+  else
+  {
+    //nothing drawn this frame overlaps this range and the buffer was orphaned in begin()
+    glState().bindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+    void *target = glMapBufferRange(GL_ARRAY_BUFFER, drawn * 4 * sizeof(BatchVertex), bytes, flags);
+    memcpy(target, staging.data() + drawn * 4, bytes);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+  }
+  glState().bindVertexArray(vertexArray);
+  glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)(quads * 6), GL_UNSIGNED_INT, 0, baseVertex);
+  drawn = written;
+  counters.draws++;
+  counters.bytes += bytes;
+}
+
+void QuadBatcher::end()
+{
+  flush();
+  if (mapped)
+  {
+    fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    region = (region + 1) % REGIONS;
+  }
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include "config.h"
+#include <vector>
+
+//one corner in the layout shader.vs reads: position, color, texture coords
+struct BatchVertex
+{
+  float position[3];
+  float color[3];
+  float texCoord[2];
+};
+
+/*
+* Streams quads that change every frame (sprites, particles, UI) into one
+* big vertex buffer and draws them with as few glDrawElements as possible.
+* The buffer is split into three regions, one per frame in flight, each
+* guarded by a fence. With ARB_buffer_storage it is mapped once, quads are
+* written straight into the region of the current frame, and a region is
+* only reused once its fence says the GPU is done with it, which with three
+* of them it practically always is, so nothing waits.
+* Without buffer storage the quads are collected on the CPU, the buffer is
+* orphaned at the start of every frame and each flush maps just its range
+* unsynchronized.
+* The caller binds the program (shader.vs layout), textures and uniforms;
+* flush() draws what was added since the last flush with them.
+*/
+class QuadBatcher
+{
+  public:
+    //maxQuads is per frame; more than that in a frame moves on to the next region early
+    explicit QuadBatcher(size_t maxQuads = 16384);
+    ~QuadBatcher();
+    QuadBatcher(const QuadBatcher&) = delete;
+    QuadBatcher& operator=(const QuadBatcher&) = delete;
+
+    //starts a frame, waits only if the GPU is still reading the region from three frames ago
+    void begin();
+    //four corners to fill in: top right, bottom right, bottom left, top left (like the square in main)
+    BatchVertex *quad();
+    //axis aligned quad with the whole texture
+    void quad(float x0, float y0, float x1, float y1, float z, float r, float g, float b);
+    //draws the quads added since the last flush, call when the bound state has to change
+    void flush();
+    //flushes and fences the frame's region
+    void end();
+
+    struct Stats
+    {
+      uint64_t quads = 0;
+      uint64_t draws = 0;
+      uint64_t bytes = 0;
+      //begin() calls that had to block on a fence
+      uint64_t waits = 0;
+    };
+    const Stats &stats() const { return counters; }
+    bool persistentlyMapped() const { return mapped != nullptr; }
+
+  private:
+    static const int REGIONS = 3;
+
+    GLuint vertexArray = 0;
+    GLuint vertexBuffer = 0;
+    GLuint elementBuffer = 0;
+    size_t maxQuads;
+    BatchVertex *mapped = nullptr;
+    //the fallback path writes here and copies on flush
+    std::vector<BatchVertex> staging;
+    GLsync fences[REGIONS] = {};
+    int region = 0;
+    size_t written = 0;
+    size_t drawn = 0;
+    Stats counters;
+};
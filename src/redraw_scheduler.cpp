@@ -0,0 +1,86 @@
+#include "redraw_scheduler.h"
+#include "cpu_profiler.h"
+
+RedrawScheduler::RedrawScheduler(GLFWwindow *window, bool onDemand) : window(window), onDemand(onDemand && window)
+{
+  if (!window)
+  {
+    return;
+  }
+  glfwSetWindowUserPointer(window, this);
+  glfwSetKeyCallback(window, [](GLFWwindow *window, int, int, int, int) { onInput(window); });
+  glfwSetMouseButtonCallback(window, [](GLFWwindow *window, int, int, int) { onInput(window); });
+  glfwSetCursorPosCallback(window, [](GLFWwindow *window, double, double) { onInput(window); });
+  glfwSetScrollCallback(window, [](GLFWwindow *window, double, double) { onInput(window); });
+  glfwSetWindowSizeCallback(window, [](GLFWwindow *window, int, int) { onInput(window); });
+  glfwSetWindowRefreshCallback(window, [](GLFWwindow *window) { onInput(window); });
+  glfwSetWindowFocusCallback(window, [](GLFWwindow *window, int) { onInput(window); });
+}
+
+void RedrawScheduler::onInput(GLFWwindow *window)
+{
+  static_cast<RedrawScheduler*>(glfwGetWindowUserPointer(window))->request();
+}
+
+void RedrawScheduler::requestAt(double time)
+{
+  if (timer == 0.0 || time < timer)
+  {
+    timer = time;
+  }
+}
+
+bool RedrawScheduler::shouldDraw(double now) const
+{
+  return !onDemand || pending || animating || (timer != 0.0 && now >= timer);
+}
+
+void RedrawScheduler::drawn(double now)
+{
+  pending = false;
+  if (timer != 0.0 && now >= timer)
+  {
+    timer = 0.0;
+  }
+  drewThisIteration = true;
+}
+
+void RedrawScheduler::waitEvents(double maxIdle)
+{
+  CPU_ZONE("waitEvents");
+  if (drewThisIteration)
+  {
+    counters.drawn++;
+  }
+  else
+  {
+    counters.skipped++;
+  }
+  drewThisIteration = false;
+  bool busy = !onDemand || pending || animating;
+  //animate() has to be called again next iteration to keep going
+  animating = false;
+  if (!window)
+  {
+    return;
+  }
+  if (busy)
+  {
+    glfwPollEvents();
+    return;
+  }
+  double timeout = maxIdle;
+  if (timer != 0.0)
+  {
+    double untilTimer = timer - glfwGetTime();
+    timeout = untilTimer < timeout ? untilTimer : timeout;
+  }
+  if (timeout > 0.0)
+  {
+    glfwWaitEventsTimeout(timeout);
+  }
+  else
+  {
+    glfwPollEvents();
+  }
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "config.h"
+
+/*
+* Decides which loop iterations actually draw, so a window showing a still
+* scene costs next to nothing.
+* On demand, a frame is only drawn when something asked for one: input,
+* a resize or expose of the window (the scheduler installs those GLFW
+* callbacks), request() from code that changed the scene (a shader reload,
+* a finished upload), animate() from anything still moving, or a timer from
+* requestAt(). In between, waitEvents() sleeps in glfwWaitEventsTimeout
+* instead of spinning, waking for the next event, the next timer or after
+* maxIdle seconds so non-GLFW sources (file watching) still get polled.
+* Continuous mode draws every iteration, like a plain render loop.
+*/
+class RedrawScheduler
+{
+  public:
+    //takes over the window's key, mouse, scroll, size, refresh and focus callbacks and its user pointer;
+    //without a window (headless) there are no events and every iteration draws
+    explicit RedrawScheduler(GLFWwindow *window, bool onDemand = true);
+    RedrawScheduler(const RedrawScheduler&) = delete;
+    RedrawScheduler& operator=(const RedrawScheduler&) = delete;
+
+    void setOnDemand(bool enabled) { onDemand = enabled; }
+    bool isOnDemand() const { return onDemand; }
+
+    //the scene changed, draw it once
+    void request() { pending = true; }
+    //keeps frames coming, call it every iteration something is still moving
+    void animate() { animating = true; }
+    //draw once at time (glfwGetTime seconds), e.g. the next step of a slow animation
+    void requestAt(double time);
+
+    //whether this iteration has to draw
+    bool shouldDraw(double now) const;
+    //call after drawing
+    void drawn(double now);
+    //polls events, or sleeps for them when nothing needs drawing
+    void waitEvents(double maxIdle = 0.25);
+
+    struct Stats
+    {
+      uint64_t drawn = 0;
+      uint64_t skipped = 0;
+    };
+    const Stats &stats() const { return counters; }
+
+  private:
+    static void onInput(GLFWwindow *window);
+
+    GLFWwindow *window;
+    bool onDemand;
+    bool pending = true;
+    bool animating = false;
+    //0 when no timer is set
+    double timer = 0.0;
+    bool drewThisIteration = false;
+    Stats counters;
+};
@@ -0,0 +1,104 @@
+#include "render_queue.h"
+#include "gl_state.h"
+#include "cpu_profiler.h"
+
+void RenderQueue::submit(uint64_t key, const DrawItem &item)
+{
+  entries.push_back({key, (uint32_t)items.size()});
+  items.push_back(item);
+}
+
+void RenderQueue::append(const CommandList &list)
+{
+  uint32_t first = (uint32_t)items.size();
+  entries.reserve(entries.size() + list.keys.size());
+  for (size_t i = 0; i < list.keys.size(); i++)
+  {
+    entries.push_back({list.keys[i], first + (uint32_t)i});
+  }
+  items.insert(items.end(), list.items.begin(), list.items.end());
+}
+
+void RenderQueue::sort()
+{
+  scratch.resize(entries.size());
+  //which bits differ at all: identical passes, shaders etc. cost nothing
+  uint64_t first = entries.empty() ? 0 : entries[0].key;
+  uint64_t differing = 0;
+  for (const Entry &entry : entries)
+  {
+    differing |= entry.key ^ first;
+  }
+  for (int shift = 0; shift < 64; shift += 8)
+  {
+    if (!((differing >> shift) & 0xFF))
+    {
+      continue;
+    }
+    uint32_t counts[256] = {};
+    for (const Entry &entry : entries)
+    {
+      counts[(entry.key >> shift) & 0xFF]++;
+    }
+    uint32_t offset = 0;
+    for (uint32_t &count : counts)
+    {
+      uint32_t next = offset + count;
+      count = offset;
+      offset = next;
+    }
+    //stable, so the order of earlier digits (and of equal keys: submission order) is kept
+    for (const Entry &entry : entries)
+    {
+      scratch[counts[(entry.key >> shift) & 0xFF]++] = entry;
+    }
+    entries.swap(scratch);
+  }
+}
+
+void RenderQueue::execute()
+{
+  CPU_ZONE("RenderQueue::execute");
+  sort();
+  lastStats = Stats();
+  const Shader *shader = nullptr;
+  GLuint vertexArray = 0;
+  GLuint texture = 0;
+  for (const Entry &entry : entries)
+  {
+    const DrawItem &item = items[entry.item];
+    if (item.shader && item.shader != shader)
+    {
+      item.shader->use();
+      shader = item.shader;
+      lastStats.programChanges++;
+    }
+    if (item.texture && item.texture != texture)
+    {
+      glState().bindTextureUnit(0, item.textureTarget, item.texture);
+      texture = item.texture;
+      lastStats.textureChanges++;
+    }
+    if (item.vertexArray && item.vertexArray != vertexArray)
+    {
+      glState().bindVertexArray(item.vertexArray);
+      vertexArray = item.vertexArray;
+      lastStats.vertexArrayChanges++;
+    }
+    if (item.uniforms.buffer)
+    {
+      glState().bindBufferRange(GL_UNIFORM_BUFFER, item.uniformBinding, item.uniforms.buffer, item.uniforms.offset, item.uniforms.size);
+    }
+    if (item.indexType)
+    {
+      glDrawElementsInstanced(item.mode, item.count, item.indexType, item.offset, item.instances);
+    }
+    else
+    {
+      glDrawArraysInstanced(item.mode, item.first, item.count, item.instances);
+    }
+    lastStats.draws++;
+  }
+  entries.clear();
+  items.clear();
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include "config.h"
+#include "uniform_buffer.h"
+#include <vector>
+
+/*
+* Draws are recorded as a 64-bit sort key plus the state they need, then
+* sorted and submitted together once per frame, so draws sharing a
+* program, material or mesh run back to back and the state changes
+* between them are as few as the key order allows.
+* Key layout, most significant first:
+*   pass (4 bits) | shader (12) | material (16) | mesh (8) | depth (24)
+* Shader, material and mesh are small ids the caller hands out (the order
+* of ids is the order of switches). Depth sorts front to back, which is
+* what opaque passes want; transparent passes use backToFront(depth).
+*/
+namespace sortkey
+{
+  const int PASS_SHIFT = 60;
+  const int SHADER_SHIFT = 48;
+  const int MATERIAL_SHIFT = 32;
+  const int MESH_SHIFT = 24;
+  const uint32_t DEPTH_MAX = (1u << 24) - 1;
+
+  //depth in [0, 1], clamped and quantized to 24 bits
+  inline uint32_t quantizeDepth(float depth)
+  {
+    depth = depth < 0.0f ? 0.0f : depth > 1.0f ? 1.0f : depth;
+    return (uint32_t)(depth * DEPTH_MAX);
+  }
+  inline uint32_t backToFront(uint32_t depth)
+  {
+    return DEPTH_MAX - depth;
+  }
+  inline uint64_t make(uint32_t pass, uint32_t shader, uint32_t material, uint32_t mesh, uint32_t depth)
+  {
+    return (uint64_t)(pass & 0xF) << PASS_SHIFT | (uint64_t)(shader & 0xFFF) << SHADER_SHIFT
+         | (uint64_t)(material & 0xFFFF) << MATERIAL_SHIFT | (uint64_t)(mesh & 0xFF) << MESH_SHIFT | (depth & DEPTH_MAX);
+  }
+}
+
+//everything one draw binds; 0 / nullptr fields leave that state as it is
+struct DrawItem
+{
+  Shader *shader = nullptr;
+  GLuint vertexArray = 0;
+  GLenum textureTarget = GL_TEXTURE_2D;
+  GLuint texture = 0;
+  //per draw uniform block (UniformBlockBuffer::range), bound at uniformBinding
+  GLuint uniformBinding = 0;
+  UniformRange uniforms;
+
+  GLenum mode = GL_TRIANGLES;
+  //indexed when indexType is set, offset is then a byte offset into the element buffer
+  GLenum indexType = 0;
+  GLsizei count = 0;
+  GLint first = 0;
+  const void *offset = nullptr;
+  GLsizei instances = 1;
+};
+
+/*
+* Draws recorded by one job. Recording only fills memory and makes no GL
+* calls, so any number of lists can be filled on worker threads at once
+* (see CommandRecorder); the GL thread then appends them to the RenderQueue.
+* A list must only be touched by one thread at a time.
+*/
+class CommandList
+{
+  public:
+    void submit(uint64_t key, const DrawItem &item)
+    {
+      keys.push_back(key);
+      items.push_back(item);
+    }
+    //keeps the memory for the next frame
+    void clear()
+    {
+      keys.clear();
+      items.clear();
+    }
+    size_t size() const { return keys.size(); }
+
+  private:
+    friend class RenderQueue;
+    std::vector<uint64_t> keys;
+    std::vector<DrawItem> items;
+};
+
+class RenderQueue
+{
+  public:
+    void submit(uint64_t key, const DrawItem &item);
+    //takes every draw recorded into list; the list itself is left as it is
+    void append(const CommandList &list);
+    //sorts by key and issues every draw, then empties the queue
+    void execute();
+    size_t size() const { return items.size(); }
+
+    //what the last execute() did
+    struct Stats
+    {
+      uint32_t draws = 0;
+      uint32_t programChanges = 0;
+      uint32_t textureChanges = 0;
+      uint32_t vertexArrayChanges = 0;
+    };
+    const Stats &stats() const { return lastStats; }
+
+  private:
+    struct Entry
+    {
+      uint64_t key;
+      uint32_t item;
+    };
+    //LSD radix sort on 8-bit digits, digits every key shares are skipped
+    void sort();
+
+    std::vector<Entry> entries;
+    std::vector<Entry> scratch;
+    std::vector<DrawItem> items;
+    Stats lastStats;
+};
@@ -0,0 +1,61 @@
+#include "shader_permutations.h"
+#include "shader_preprocessor.h"
+#include "shader_reload.h"
+
+ShaderPermutations::ShaderPermutations(const std::string &vertexPath, const std::string &fragmentPath,
+                                       const std::vector<std::string> &features, ShaderReloader *reloader)
+  : vertexPath(vertexPath), fragmentPath(fragmentPath), features(features), reloader(reloader)
+{
+}
+
+ShaderPermutations::~ShaderPermutations()
+{
+  for (auto &entry : variants)
+  {
+    Variant &variant = entry.second;
+    if (variant.building)
+    {
+      glDeleteProgram(finishProgramBuild(variant.build));
+    }
+    if (variant.shader)
+    {
+      if (reloader)
+      {
+        reloader->forget(*variant.shader);
+      }
+      glDeleteProgram(variant.shader->ID);
+    }
+  }
+}
+
+void ShaderPermutations::prepare(uint32_t mask)
+{
+  if (variants.count(mask))
+  {
+    return;
+  }
+  Variant &variant = variants[mask];
+  std::string defines = featureDefines(mask, features);
+  PreprocessedShader vertex;
+  PreprocessedShader fragment;
+  preprocessShader(vertexPath, defines, vertex);
+  preprocessShader(fragmentPath, defines, fragment);
+  variant.build = beginProgramBuild(vertex.code, fragment.code, vertexPath + " + " + fragmentPath + " [" + std::to_string(mask) + "]");
+  variant.building = true;
+}
+
+Shader &ShaderPermutations::get(uint32_t mask)
+{
+  prepare(mask);
+  Variant &variant = variants[mask];
+  if (variant.building)
+  {
+    variant.building = false;
+    variant.shader.reset(new Shader(finishProgramBuild(variant.build)));
+    if (reloader)
+    {
+      reloader->watch(*variant.shader, vertexPath, fragmentPath, featureDefines(mask, features));
+    }
+  }
+  return *variant.shader;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "config.h"
+#include <memory>
+#include <unordered_map>
+
+class ShaderReloader;
+
+/*
+* Every variant of one vertex/fragment pair, keyed by a bitmask of features.
+* Bit i of the mask puts "#define features[i] 1" after #version in both
+* stages, so a variant's #ifdef blocks are folded by the compiler instead
+* of branching per fragment on a uniform.
+* Variants are built the first time they are asked for and kept; prepare()
+* issues a build early so get() later only waits for what is left of it.
+* Binaries go through the program cache like any other program.
+*/
+class ShaderPermutations
+{
+  public:
+    //at most 32 features; with a reloader every built variant is rebuilt when its files change
+    ShaderPermutations(const std::string &vertexPath, const std::string &fragmentPath,
+                       const std::vector<std::string> &features, ShaderReloader *reloader = nullptr);
+    ~ShaderPermutations();
+    ShaderPermutations(const ShaderPermutations&) = delete;
+    ShaderPermutations& operator=(const ShaderPermutations&) = delete;
+
+    //issues the variant's build without waiting for it
+    void prepare(uint32_t features);
+    //the variant, built now if it has not been prepared; a failed build gives a shader with ID 0
+    //the reference stays valid as long as the registry does
+    Shader &get(uint32_t features);
+
+    size_t variantCount() const { return variants.size(); }
+
+  private:
+    struct Variant
+    {
+      std::unique_ptr<Shader> shader;
+      bool building = false;
+      ProgramBuild build;
+    };
+
+    std::string vertexPath;
+    std::string fragmentPath;
+    std::vector<std::string> features;
+    ShaderReloader *reloader;
+    std::unordered_map<uint32_t, Variant> variants;
+};
@@ -0,0 +1,106 @@
+#include "shader_preprocessor.h"
+#include "shader_sources.h"
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+static std::string directoryOf(const std::string &path)
+{
+  size_t slash = path.find_last_of('/');
+  return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+}
+
+//the quoted name if line is an #include, empty otherwise
+static std::string includedName(const std::string &line)
+{
+  size_t at = line.find_first_not_of(" \t");
+  if (at == std::string::npos || line.compare(at, 1, "#") != 0)
+  {
+    return "";
+  }
+  at = line.find_first_not_of(" \t", at + 1);
+  if (at == std::string::npos || line.compare(at, 7, "include") != 0)
+  {
+    return "";
+  }
+  size_t open = line.find('"', at + 7);
+  size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+  return close == std::string::npos ? "" : line.substr(open + 1, close - open - 1);
+}
+
+static bool isVersion(const std::string &line)
+{
+  size_t at = line.find_first_not_of(" \t");
+  return at != std::string::npos && line.compare(at, 8, "#version") == 0;
+}
+
+static bool expand(const std::string &path, const std::string &defines, PreprocessedShader &result, std::string &out)
+{
+  std::string source;
+  if (!loadShaderSource(path, source))
+  {
+    return false;
+  }
+  int fileIndex = (int)result.files.size();
+  result.files.push_back(path);
+
+  std::istringstream lines(source);
+  std::string line;
+  int number = 0;
+  bool top = fileIndex == 0;
+  bool injected = false;
+  while (std::getline(lines, line))
+  {
+    number++;
+    std::string name = includedName(line);
+    if (!name.empty())
+    {
+      std::string included = directoryOf(path) + name;
+      //a file already in, or on the way in, is skipped, which also ends include cycles
+      if (std::find(result.files.begin(), result.files.end(), included) == result.files.end())
+      {
+        out += "#line 1 " + std::to_string(result.files.size()) + "\n";
+        if (!expand(included, "", result, out))
+        {
+          std::cout << "  included from " << path << ":" << number << std::endl;
+          return false;
+        }
+      }
+      out += "#line " + std::to_string(number + 1) + " " + std::to_string(fileIndex) + "\n";
+      continue;
+    }
+    out += line + "\n";
+    //defines have to come after #version, which has to come before anything else
+    if (top && !injected && isVersion(line))
+    {
+      out += defines;
+      out += "#line " + std::to_string(number + 1) + " 0\n";
+      injected = true;
+    }
+  }
+  if (top && !injected && !defines.empty())
+  {
+    //no #version means GLSL 1.10, where defines may simply go first
+    out = defines + "#line 1 0\n" + out;
+  }
+  return true;
+}
+
+bool preprocessShader(const std::string &path, const std::string &defines, PreprocessedShader &result)
+{
+  result = PreprocessedShader();
+  return expand(path, defines, result, result.code);
+}
+
+std::string featureDefines(uint32_t features, const std::vector<std::string> &names)
+{
+  std::string defines;
+  for (size_t bit = 0; bit < names.size() && bit < 32; bit++)
+  {
+    if (features & (1u << bit))
+    {
+      defines += "#define " + names[bit] + " 1\n";
+    }
+  }
+  return defines;
+}
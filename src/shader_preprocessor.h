@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+* The bit of preprocessing GLSL lacks: #include "file" (relative to the
+* including file, each file at most once, like #pragma once) and defines
+* injected right after #version. #line directives keep driver errors
+* pointing at the right line; the source string number in them is the
+* index into files.
+*/
+struct PreprocessedShader
+{
+  std::string code;
+  //every file that went into code, the top level one first; what hot reload has to watch
+  std::vector<std::string> files;
+};
+
+//path is a shader name (shader_sources.h), includes are resolved relative to it
+//false (and logs) if a file cannot be read
+bool preprocessShader(const std::string &path, const std::string &defines, PreprocessedShader &result);
+
+//"#define NAME 1" for every set bit, bit i naming names[i]
+std::string featureDefines(uint32_t features, const std::vector<std::string> &names);
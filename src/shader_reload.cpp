@@ -0,0 +1,134 @@
+#include "shader_reload.h"
+#include "shader_preprocessor.h"
+#include "shader_sources.h"
+#include <algorithm>
+
+ShaderReloader::~ShaderReloader()
+{
+  for (Watched &watched : shaders)
+  {
+    if (watched.building)
+    {
+      glDeleteProgram(finishProgramBuild(watched.build));
+    }
+  }
+}
+
+void ShaderReloader::watch(Shader &shader, const std::string &vertexPath, const std::string &fragmentPath, const std::string &defines)
+{
+  //embedded shaders cannot change while running
+  if (shaderSourceMode() != ShaderSourceMode::Disk)
+  {
+    return;
+  }
+  Watched watched;
+  watched.shader = &shader;
+  watched.vertexPath = vertexPath;
+  watched.fragmentPath = fragmentPath;
+  watched.defines = defines;
+  //only to learn the includes, the shader itself is already built
+  PreprocessedShader vertex;
+  PreprocessedShader fragment;
+  preprocessShader(vertexPath, defines, vertex);
+  preprocessShader(fragmentPath, defines, fragment);
+  vertex.files.insert(vertex.files.end(), fragment.files.begin(), fragment.files.end());
+  //the stages themselves even if they could not be read just now
+  vertex.files.push_back(vertexPath);
+  vertex.files.push_back(fragmentPath);
+  watchFiles(watched, vertex.files);
+  shaders.push_back(std::move(watched));
+}
+
+void ShaderReloader::watchFiles(Watched &watched, const std::vector<std::string> &files)
+{
+  for (const std::string &name : files)
+  {
+    std::string file = shaderFilePath(name);
+    if (std::find(watched.files.begin(), watched.files.end(), file) == watched.files.end())
+    {
+      watcher.watch(file);
+      watched.files.push_back(file);
+    }
+  }
+}
+
+void ShaderReloader::forget(Shader &shader)
+{
+  for (auto it = shaders.begin(); it != shaders.end();)
+  {
+    if (it->shader != &shader)
+    {
+      ++it;
+      continue;
+    }
+    if (it->building)
+    {
+      glDeleteProgram(finishProgramBuild(it->build));
+    }
+    it = shaders.erase(it);
+  }
+}
+
+int ShaderReloader::update()
+{
+  int swapped = 0;
+  for (const std::string &path : watcher.changes())
+  {
+    for (Watched &watched : shaders)
+    {
+      if (std::find(watched.files.begin(), watched.files.end(), path) != watched.files.end())
+      {
+        watched.dirty = true;
+      }
+    }
+  }
+
+  for (Watched &watched : shaders)
+  {
+    if (watched.building && programBuildReady(watched.build))
+    {
+      watched.building = false;
+      GLuint program = finishProgramBuild(watched.build);
+      if (program)
+      {
+        watched.shader->replaceProgram(program);
+        swapped++;
+        std::cout << "Reloaded " << watched.build.name << std::endl;
+      }
+      else
+      {
+        std::cout << "Reload failed, keeping the previous program: " << watched.build.name << std::endl;
+      }
+    }
+    //saving again mid-build queues one more build once this one is done
+    if (watched.dirty && !watched.building)
+    {
+      watched.dirty = false;
+      PreprocessedShader vertex;
+      PreprocessedShader fragment;
+      if (!preprocessShader(watched.vertexPath, watched.defines, vertex) || !preprocessShader(watched.fragmentPath, watched.defines, fragment))
+      {
+        //deleted or renamed away mid-save, the next write marks it dirty again
+        continue;
+      }
+      //an edit may have added includes
+      watchFiles(watched, vertex.files);
+      watchFiles(watched, fragment.files);
+      watched.building = true;
+      watched.build = beginProgramBuild(vertex.code, fragment.code, watched.vertexPath + " + " + watched.fragmentPath);
+    }
+  }
+  return swapped;
+}
+
+bool ShaderReloader::busy() const
+{
+  for (const Watched &watched : shaders)
+  {
+    if (watched.building)
+    {
+      return true;
+    }
+  }
+  return false;
+}
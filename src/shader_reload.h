@@ -0,0 +1,55 @@
+#pragma once
+#include "config.h"
+#include "file_watcher.h"
+
+/*
+* Rebuilds shaders whose files change while the program runs.
+* Edits are picked up by a FileWatcher and rebuilt through the split
+* begin/finish build (program_build.h): the build is issued on the frame the
+* edit is seen and only finished once the driver reports it done, so with
+* KHR_parallel_shader_compile a reload never stalls a frame.
+* Stages go through the preprocessor, so an edit to an included file
+* rebuilds every shader that includes it.
+* Only shaders read from disk (ShaderSourceMode::Disk) are watched.
+* The new program replaces the old one only after it linked; a broken edit
+* logs its errors and the old program keeps running until the next save.
+*/
+class ShaderReloader
+{
+  public:
+    ShaderReloader() = default;
+    ~ShaderReloader();
+    ShaderReloader(const ShaderReloader&) = delete;
+    ShaderReloader& operator=(const ShaderReloader&) = delete;
+
+    //shader must outlive the reloader (or be forgotten first); defines as given to the preprocessor,
+    //files the stages #include are watched too
+    void watch(Shader &shader, const std::string &vertexPath, const std::string &fragmentPath, const std::string &defines = "");
+    void forget(Shader &shader);
+    //once per frame: issues rebuilds for edited files and swaps in the ones that are done,
+    //returns the number of programs swapped in
+    int update();
+    //a rebuild is in flight, keep calling update() until it lands
+    bool busy() const;
+
+  private:
+    struct Watched;
+    void watchFiles(Watched &watched, const std::vector<std::string> &files);
+
+    struct Watched
+    {
+      Shader *shader;
+      std::string vertexPath;
+      std::string fragmentPath;
+      std::string defines;
+      //files on disk of both stages and everything they include
+      std::vector<std::string> files;
+      //edited since the last build was issued
+      bool dirty = false;
+      bool building = false;
+      ProgramBuild build;
+    };
+
+    FileWatcher watcher;
+    std::vector<Watched> shaders;
+};
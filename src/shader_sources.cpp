@@ -0,0 +1,59 @@
+#include "shader_sources.h"
+#include "program_build.h"
+#include "embedded_shaders.h"
+#include <fstream>
+#include <sstream>
+
+static ShaderSourceMode mode = ShaderSourceMode::Embedded;
+static std::string directory;
+
+void setShaderSourceMode(ShaderSourceMode sourceMode, const std::string &sourceDirectory)
+{
+  mode = sourceMode;
+  directory = sourceDirectory;
+}
+
+ShaderSourceMode shaderSourceMode()
+{
+  return mode;
+}
+
+std::string shaderFilePath(const std::string &name)
+{
+  return mode == ShaderSourceMode::Disk ? directory + name : name;
+}
+
+static const EmbeddedShader *findEmbedded(const std::string &name)
+{
+  uint64_t hash = fnv1a64(name.c_str());
+  for (const EmbeddedShader &shader : EMBEDDED_SHADERS)
+  {
+    if (shader.nameHash == hash && name == shader.name)
+    {
+      return &shader;
+    }
+  }
+  return nullptr;
+}
+
+bool loadShaderSource(const std::string &name, std::string &source)
+{
+  if (mode == ShaderSourceMode::Disk)
+  {
+    std::ifstream file(shaderFilePath(name), std::ios::binary);
+    if (file)
+    {
+      std::stringstream stream;
+      stream << file.rdbuf();
+      source = stream.str();
+      return true;
+    }
+  }
+  if (const EmbeddedShader *embedded = findEmbedded(name))
+  {
+    source.assign(embedded->source, embedded->size);
+    return true;
+  }
+  //not ours, read it as a plain path (this one logs on failure)
+  return readShaderFile(shaderFilePath(name).c_str(), source);
+}
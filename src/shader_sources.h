@@ -0,0 +1,23 @@
+#pragma once
+#include <string>
+
+/*
+* Where shader text comes from. Shaders are named by their path relative to
+* src/shaders ("shader.vs", "materials.glsl").
+* Embedded: every file in src/shaders is compiled into the binary by the
+* build (cmake/embed_shaders.cmake), loading one is a table lookup with no
+* file I/O and no dependency on the working directory. Names that are not
+* in the table are read from disk as paths, as before.
+* Disk: names are read from a directory, for development with hot reload;
+* a file missing there falls back to the embedded copy.
+*/
+enum class ShaderSourceMode { Embedded, Disk };
+
+//directory ends in '/', only used in Disk mode
+void setShaderSourceMode(ShaderSourceMode mode, const std::string &directory = "");
+ShaderSourceMode shaderSourceMode();
+
+//the file a name is read from in the current mode
+std::string shaderFilePath(const std::string &name);
+//false (and logs) if the name is neither embedded nor readable
+bool loadShaderSource(const std::string &name, std::string &source);
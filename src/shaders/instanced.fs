@@ -0,0 +1,10 @@
+#version 330 core
+out vec4 FragColor;
+in vec2 TexCoord;
+flat in int layer;
+in vec4 tint;
+#include "materials.glsl"
+void main()
+{
+  FragColor = sampleMaterial(TexCoord, layer) * tint;
+}
@@ -0,0 +1,24 @@
+#version 330 core
+//the mesh's own attributes (the quad in main.cpp), the rest advance once per instance (InstancedMesh)
+layout (location = 0) in vec3 aPos;
+layout (location = 2) in vec2 aTexCoord;
+//xyz position, rotation in radians
+layout (location = 3) in vec4 iPlacement;
+layout (location = 4) in vec2 iScale;
+layout (location = 5) in int iLayer;
+layout (location = 6) in vec4 iColor;
+
+out vec2 TexCoord;
+flat out int layer;
+out vec4 tint;
+
+void main()
+{
+  vec2 corner = aPos.xy * iScale;
+  float s = sin(iPlacement.w);
+  float c = cos(iPlacement.w);
+  gl_Position = vec4(iPlacement.xy + vec2(c * corner.x - s * corner.y, s * corner.x + c * corner.y), iPlacement.z, 1.0);
+  TexCoord = aTexCoord;
+  layer = iLayer;
+  tint = iColor;
+}
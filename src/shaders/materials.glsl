@@ -0,0 +1,17 @@
+#ifdef SINGLE_TEXTURE
+//one GL_TEXTURE_2D per draw (from the texture cache), the layer is ignored
+uniform sampler2D materials;
+
+vec4 sampleMaterial(vec2 texCoord, int layer)
+{
+  return texture(materials, texCoord);
+}
+#else
+//every material is a layer of one array, picking one is just an index
+uniform sampler2DArray materials;
+
+vec4 sampleMaterial(vec2 texCoord, int layer)
+{
+  return texture(materials, vec3(texCoord, layer));
+}
+#endif
@@ -1,10 +1,26 @@
 #version 330 core
+//features are #defined by the permutation registry, each combination is its own program
 out vec4 FragColor;
 in vec3 ourColor;
 in vec2 TexCoord;
-uniform sampler2D texture1;
-uniform sampler2D texture2;
+#include "materials.glsl"
+//per draw parameters, one range of a buffer shared by every draw (MaterialParams in main.cpp)
+layout(std140) uniform MaterialParams
+{
+  int baseLayer;
+  int overlayLayer;
+  float overlayMix;
+  vec4 tint;
+};
 void main()
 {
-  FragColor = mix(texture(texture1, TexCoord), texture(texture2, TexCoord), 0.5);
+  vec4 color = sampleMaterial(TexCoord, baseLayer);
+#ifdef OVERLAY
+  color = mix(color, sampleMaterial(TexCoord, overlayLayer), overlayMix);
+#endif
+  color *= tint;
+#ifdef VERTEX_COLOR
+  color.rgb *= ourColor;
+#endif
+  FragColor = color;
 }
@@ -0,0 +1,156 @@
+/*
+* Cals_texture_cache_test: TextureCache checks that need a real GL context, run
+* headless (headless_context.h). Returns non-zero and says which check failed.
+*/
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include "../config.h"
+#include "../gl_ext.h"
+#include "../headless_context.h"
+#include "../texture_cache.h"
+#include "../texture_upload.h"
+
+static int failures = 0;
+
+static void check(bool condition, const char *what)
+{
+  if (!condition)
+  {
+    std::cout << "FAILED: " << what << std::endl;
+    failures++;
+  }
+}
+
+//a size x size gray binary PPM
+static bool writeImage(const std::string &path, int size, unsigned char value)
+{
+  FILE *file = fopen(path.c_str(), "wb");
+  if (!file)
+  {
+    return false;
+  }
+  fprintf(file, "P6\n%d %d\n255\n", size, size);
+  std::vector<unsigned char> row((size_t)size * 3, value);
+  for (int y = 0; y < size; y++)
+  {
+    fwrite(row.data(), 1, row.size(), file);
+  }
+  return fclose(file) == 0;
+}
+
+//runs the cache long enough for every job on the pool to have finished and been picked up
+static void drain(TextureCache &cache, TextureUploader &uploader)
+{
+  for (int i = 0; i < 200; i++)
+  {
+    uploader.update();
+    cache.update();
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  uploader.finish();
+  cache.update();
+}
+
+//released while hashing, and released once the load has started: neither may come back
+static void releaseWhileLoading(const std::string &path)
+{
+  TextureDecodePool pool;
+  TextureUploader uploader;
+  TextureCache cache(pool, uploader, (size_t)-1);
+  TextureHandle hashing = cache.load("", path);
+  cache.release(hashing);
+  drain(cache, uploader);
+  check(cache.residentBytes() == 0, "a texture released while hashing holds no VRAM");
+  check(cache.loadingCount() == 0, "a texture released while hashing is not loading");
+
+  //the load is held in the queue by blocking every worker: once all of them run a blocker the
+  //hash (queued first) is done, the next update() starts the load and it cannot finish yet
+  TextureHandle loading = cache.load("", path);
+  std::promise<void> gate;
+  std::shared_future<void> opened = gate.get_future().share();
+  std::atomic<unsigned int> blocked(0);
+  unsigned int workers = pool.threads().size();
+  std::vector<std::future<void>> blockers;
+  for (unsigned int i = 0; i < workers; i++)
+  {
+    blockers.push_back(pool.threads().submit([&blocked, opened]() { blocked++; opened.wait(); }));
+  }
+  while (blocked < workers)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  cache.update();
+  check(cache.loadingCount() == 1, "the second load is still in flight when it is released");
+  cache.release(loading);
+  gate.set_value();
+  drain(cache, uploader);
+  check(cache.residentBytes() == 0, "a texture released while loading holds no VRAM");
+  check(cache.loadingCount() == 0, "a texture released while loading is not loading");
+}
+
+//a file that hashes but does not decode fails, and a later copy of it must not alias the failure
+static void noAliasOfFailed(const std::string &first, const std::string &second)
+{
+  TextureDecodePool pool;
+  TextureUploader uploader;
+  TextureCache cache(pool, uploader, (size_t)-1);
+  TextureHandle broken = cache.load("", first);
+  drain(cache, uploader);
+  check(cache.acquire(broken) == 0, "an undecodable file has no texture");
+  cache.load("", second);
+  drain(cache, uploader);
+  check(cache.stats().deduplicated == 0, "a copy of a failed file is not deduplicated onto it");
+}
+
+static bool writeText(const std::string &path, const char *text)
+{
+  FILE *file = fopen(path.c_str(), "wb");
+  if (!file)
+  {
+    return false;
+  }
+  fputs(text, file);
+  return fclose(file) == 0;
+}
+
+int main()
+{
+  HeadlessContext context(64, 64);
+  if (!context.ok() || !gladLoadGLLoader((GLADloadproc)HeadlessContext::getProcAddress))
+  {
+    std::cout << "Failed to create a headless GL context" << std::endl;
+    return 1;
+  }
+  loadGLExtensions((GLADloadproc)HeadlessContext::getProcAddress);
+
+  char directory[] = "/tmp/cals_test_XXXXXX";
+  if (!mkdtemp(directory))
+  {
+    std::cout << "Cannot create a temporary directory" << std::endl;
+    return 1;
+  }
+  std::string image = std::string(directory) + "/large.ppm";
+  writeImage(image, 256, 128);
+
+  std::string broken = std::string(directory) + "/broken.ppm";
+  std::string brokenCopy = std::string(directory) + "/broken_copy.ppm";
+  writeText(broken, "not an image");
+  writeText(brokenCopy, "not an image");
+
+  releaseWhileLoading(image);
+  noAliasOfFailed(broken, brokenCopy);
+
+  unlink(image.c_str());
+  unlink(broken.c_str());
+  unlink(brokenCopy.c_str());
+  rmdir(directory);
+  std::cout << (failures ? "texture cache tests failed" : "texture cache tests passed") << std::endl;
+  return failures ? 1 : 0;
+}
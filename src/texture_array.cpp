@@ -0,0 +1,139 @@
+#include "texture_array.h"
+#include "texture_upload.h"
+#include "gl_ext.h"
+
+TextureArrayBuilder::TextureArrayBuilder(int width, int height, const TextureCompression &compression, int channels)
+  : width(width), height(height), channels(channels), compression(compression)
+{
+}
+
+GLenum TextureArrayBuilder::internalFormat() const
+{
+  if (compression.format != BlockFormat::None)
+  {
+    return internalFormatForBlockFormat(compression.format);
+  }
+  return internalFormatForChannels(channels);
+}
+
+bool TextureArrayBuilder::matches(const TextureContainerHeader &header) const
+{
+  return (int)header.width == width && (int)header.height == height && header.internalFormat == internalFormat()
+      && (header.compressed || (int)header.channels == channels)
+      && (int)header.levelCount == TextureUploader::mipLevelCount(width, height);
+}
+
+size_t TextureArrayBuilder::sizeInBytes() const
+{
+  size_t bytes = 0;
+  int levels = TextureUploader::mipLevelCount(width, height);
+  //build() falls back to uncompressed when the driver lacks the block format
+  GLenum format = textureFormatSupported(internalFormat()) ? internalFormat() : internalFormatForChannels(channels);
+  for (int level = 0; level < levels; level++)
+  {
+    bytes += textureLevelBytes(format, std::max(1, width >> level), std::max(1, height >> level));
+  }
+  return bytes * layers.size();
+}
+
+int TextureArrayBuilder::addLayer(TextureDecodePool &pool, const std::string &bakedPath, const std::string &sourcePath, bool flipVertically)
+{
+  Layer layer;
+  layer.baked = TextureContainer::open(bakedPath);
+  if (layer.baked && !matches(layer.baked->header()))
+  {
+    std::cout << "Baked texture does not match its texture array, decoding " << sourcePath << std::endl;
+    layer.baked = nullptr;
+  }
+  layer.sourcePath = sourcePath;
+  layer.options.flipVertically = flipVertically;
+  layer.options.desiredChannels = channels;
+  layer.options.width = width;
+  layer.options.height = height;
+  layer.options.compression = compression;
+  if (!layer.baked)
+  {
+    layer.decoded = pool.decode(sourcePath, layer.options);
+  }
+  layers.push_back(std::move(layer));
+  return (int)layers.size() - 1;
+}
+
+unsigned int TextureArrayBuilder::build(TextureUploader &uploader)
+{
+  if (layers.empty())
+  {
+    return 0;
+  }
+  if (!textureFormatSupported(internalFormat()))
+  {
+    //same fallback as the single textures: the array is built uncompressed instead (slow path, logged)
+    std::cout << "Texture array format not supported by the driver, uploading uncompressed" << std::endl;
+    compression = TextureCompression();
+  }
+  GLenum format = internalFormat();
+  bool compressed = compression.format != BlockFormat::None;
+  int levels = TextureUploader::mipLevelCount(width, height);
+  int layerCount = (int)layers.size();
+  unsigned int texture = TextureUploader::createTextureArray(format, width, height, layerCount, levels);
+  //decoded uncompressed layers only bring level 0, they go last and the GPU builds
+  //the mips of every layer once the final one is in
+  std::vector<std::pair<int, std::shared_ptr<DecodedImage>>> baseLevelsOnly;
+  for (int i = 0; i < layerCount; i++)
+  {
+    Layer &layer = layers[i];
+    std::shared_ptr<DecodedImage> image;
+    if (layer.baked && !matches(layer.baked->header()))
+    {
+      //baked for the block format the driver lacks, decode the source instead
+      std::cout << "Baked texture format not supported by the driver, decoding " << layer.sourcePath << std::endl;
+      layer.options.compression = compression;
+      image = std::make_shared<DecodedImage>(decodeImage(layer.sourcePath, layer.options));
+    }
+    else if (layer.baked)
+    {
+      const TextureContainerHeader &header = layer.baked->header();
+      for (uint32_t level = 0; level < header.levelCount; level++)
+      {
+        const TextureContainerLevel &info = layer.baked->level(level);
+        const unsigned char *data = layer.baked->levelData(level);
+        if (compressed)
+        {
+          uploader.enqueueCompressed(texture, level, info.width, info.height, format, data, layer.baked, i);
+        }
+        else
+        {
+          uploader.enqueue(texture, level, info.width, info.height, channels, data, layer.baked, false, i);
+        }
+      }
+      continue;
+    }
+    else
+    {
+      image = std::make_shared<DecodedImage>(layer.decoded.get());
+    }
+    if (!image->ok())
+    {
+      std::cout << "Texture load failed: " << image->path << std::endl;
+      continue;
+    }
+    if (!compressed)
+    {
+      baseLevelsOnly.emplace_back(i, image);
+      continue;
+    }
+    for (int level = 0; level < (int)image->compressedLevels.size(); level++)
+    {
+      const MipLevel &mip = image->compressedLevels[level];
+      uploader.enqueueCompressed(texture, level, mip.width, mip.height, format, mip.pixels.data(), image, i);
+    }
+  }
+  for (size_t i = 0; i < baseLevelsOnly.size(); i++)
+  {
+    const std::shared_ptr<DecodedImage> &image = baseLevelsOnly[i].second;
+    bool last = i + 1 == baseLevelsOnly.size();
+    uploader.enqueue(texture, 0, width, height, channels, image->pixels.get(), image, last, baseLevelsOnly[i].first);
+  }
+  layers.clear();
+  return texture;
+}
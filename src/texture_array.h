@@ -0,0 +1,47 @@
+#pragma once
+#include "config.h"
+#include "texture_loader.h"
+
+class TextureUploader;
+
+/*
+* Packs several textures into the layers of one GL_TEXTURE_2D_ARRAY so a
+* shader picks a material by layer index and nothing has to be rebound
+* between draws. Every layer shares the array's size and format: layers
+* are resampled to fit while decoding, and a baked .ctex is used as is only
+* when it already matches (same size, format and mip count).
+*/
+class TextureArrayBuilder
+{
+  public:
+    //channels is used for uncompressed arrays (3 = GL_RGB8), compression applies to every layer
+    TextureArrayBuilder(int width, int height, const TextureCompression &compression, int channels = 3);
+
+    //starts loading a layer right away and returns its index
+    int addLayer(TextureDecodePool &pool, const std::string &bakedPath, const std::string &sourcePath, bool flipVertically = true);
+    //waits for any decode still running and queues every layer on the uploader
+    //the array is complete once the uploader has drained its queue, returns 0 on failure
+    unsigned int build(TextureUploader &uploader);
+
+    int layerCount() const { return (int)layers.size(); }
+    //VRAM the array takes once built, all layers and levels
+    size_t sizeInBytes() const;
+
+  private:
+    struct Layer
+    {
+      std::shared_ptr<TextureContainer> baked;
+      std::future<DecodedImage> decoded;
+      std::string sourcePath;
+      DecodeOptions options;
+    };
+
+    bool matches(const TextureContainerHeader &header) const;
+    GLenum internalFormat() const;
+
+    int width;
+    int height;
+    int channels;
+    TextureCompression compression;
+    std::vector<Layer> layers;
+};
@@ -0,0 +1,531 @@
+#include "texture_cache.h"
+#include "gl_state.h"
+#include "texture_upload.h"
+#include "hash.h"
+#include "cpu_profiler.h"
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+//levels this small stay on the CPU for demotion, a whole RGBA8 tail below 64x64 is ~22KB
+static const int TAIL_SIZE = 64;
+//levels queued ahead of the one sampled, per texture, so a slow uploader is not buried
+static const size_t MAX_LEVELS_IN_FLIGHT = 2;
+//how much GL_TEXTURE_MIN_LOD drops per frame when a finer level lands, 4 frames per level
+static const float LOD_FADE_STEP = 0.25f;
+
+static bool ready(const std::future<uint64_t> &job)
+{
+  return job.valid() && job.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+static bool ready(const std::future<TextureLevels> &job)
+{
+  return job.valid() && job.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+//identical files decoded differently are different textures
+static std::string optionsKey(const DecodeOptions &options)
+{
+  return std::to_string(options.flipVertically) + "," + std::to_string(options.desiredChannels) + ","
+       + std::to_string(options.width) + "x" + std::to_string(options.height) + ","
+       + std::to_string((int)options.compression.format) + "," + std::to_string((int)options.compression.quality);
+}
+
+//sampler state on the texture itself, so shaders need no changes to stay on resident levels
+static void setLevelClamp(unsigned int texture, int baseLevel, float minLod)
+{
+  glState().bindTexture(GL_TEXTURE_2D, texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, baseLevel);
+  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_LOD, minLod);
+}
+
+TextureCache::TextureCache(TextureDecodePool &pool, TextureUploader &uploader, size_t budgetBytes)
+  : pool(pool), uploader(uploader), budgetBytes(budgetBytes)
+{
+}
+
+TextureCache::~TextureCache()
+{
+  //the uploader may still hold rows for these, let it finish before the names go away
+  uploader.finish();
+  for (Entry &entry : entries)
+  {
+    if (entry.texture)
+    {
+      glState().deleteTextures(1, &entry.texture);
+    }
+    if (entry.incoming)
+    {
+      glState().deleteTextures(1, &entry.incoming);
+    }
+  }
+  for (auto &texture : retired)
+  {
+    glState().deleteTextures(1, &texture.first);
+  }
+}
+
+TextureCache::Entry &TextureCache::resolve(TextureHandle handle)
+{
+  while (entries[handle].state == State::Alias)
+  {
+    handle = entries[handle].aliasOf;
+  }
+  return entries[handle];
+}
+
+TextureHandle TextureCache::load(const std::string &bakedPath, const std::string &sourcePath, const DecodeOptions &options)
+{
+  //the same request again skips even the hashing
+  std::string pathKey = bakedPath + "|" + sourcePath + "|" + optionsKey(options);
+  auto known = byPath.find(pathKey);
+  if (known != byPath.end())
+  {
+    resolve(known->second).references++;
+    return known->second;
+  }
+
+  TextureHandle handle = (TextureHandle)entries.size();
+  entries.emplace_back();
+  Entry &entry = entries.back();
+  entry.pathKey = pathKey;
+  entry.bakedPath = bakedPath;
+  entry.sourcePath = sourcePath;
+  entry.options = options;
+  entry.lastUsedFrame = frame;
+  byPath[pathKey] = handle;
+
+  uint64_t seed = fnv1a64(optionsKey(options).c_str());
+  entry.hashJob = pool.threads().submit([bakedPath, sourcePath, seed]() -> uint64_t
+  {
+    //hash whatever would be loaded: the baked file when there is one
+    std::ifstream file(bakedPath, std::ios::binary);
+    if (!file)
+    {
+      file.open(sourcePath, std::ios::binary);
+    }
+    if (!file)
+    {
+      return 0;
+    }
+    std::vector<char> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return hashBytes(contents.data(), contents.size(), seed);
+  });
+  return handle;
+}
+
+TextureHandle TextureCache::adopt(unsigned int texture, size_t bytes)
+{
+  TextureHandle handle = (TextureHandle)entries.size();
+  entries.emplace_back();
+  Entry &entry = entries.back();
+  entry.state = State::Resident;
+  entry.pinned = true;
+  entry.texture = texture;
+  entry.bytes = bytes;
+  entry.fullBytes = bytes;
+  entry.lastUsedFrame = frame;
+  return handle;
+}
+
+void TextureCache::release(TextureHandle handle)
+{
+  Entry &entry = resolve(handle);
+  if (--entry.references > 0)
+  {
+    return;
+  }
+  stopStreaming(entry);
+  retire(entry.texture);
+  retire(entry.incoming);
+  entry.texture = entry.incoming = 0;
+  entry.bytes = entry.incomingBytes = 0;
+  entry.tail.reset();
+  //a hash or load still running is dropped, its result must not bring the texture back
+  entry.hashJob = std::future<uint64_t>();
+  entry.loadJob = std::future<TextureLevels>();
+  entry.state = State::Released;
+  //aliases pointing here are released with it, their path keys go too
+  for (auto it = byPath.begin(); it != byPath.end();)
+  {
+    it = resolve(it->second).state == State::Released ? byPath.erase(it) : std::next(it);
+  }
+  if (entry.contentHash)
+  {
+    byContent.erase(entry.contentHash);
+  }
+}
+
+unsigned int TextureCache::acquire(TextureHandle handle)
+{
+  Entry &entry = resolve(handle);
+  entry.lastUsedFrame = frame;
+  if ((entry.state == State::Demoted || entry.state == State::Evicted) && !entry.incoming && !entry.loadJob.valid())
+  {
+    counters.reloaded++;
+    //the small mips are still on the CPU, put them back now so there is something to draw
+    //(a reload, not a demotion: the budget counters are left alone)
+    if (entry.state == State::Evicted && uploadTail(entry))
+    {
+      entry.state = State::Demoted;
+    }
+    startLoad(entry);
+  }
+  return entry.texture;
+}
+
+void TextureCache::startLoad(Entry &entry)
+{
+  entry.loadJob = pool.loadLevels(entry.bakedPath, entry.sourcePath, entry.options);
+  if (entry.state == State::Hashing)
+  {
+    entry.state = State::Loading;
+  }
+}
+
+void TextureCache::finishLoad(Entry &entry, TextureLevels &&levels)
+{
+  if (!levels.ok())
+  {
+    if (!entry.texture)
+    {
+      entry.state = State::Failed;
+      //later files with the same contents load (and fail) on their own instead of aliasing this one
+      auto known = byContent.find(entry.contentHash);
+      if (known != byContent.end() && &entries[known->second] == &entry)
+      {
+        byContent.erase(known);
+      }
+    }
+    return;
+  }
+  entry.internalFormat = levels.internalFormat;
+  entry.channels = levels.channels;
+  entry.compressed = levels.compressed;
+  entry.fullBytes = 0;
+  for (const TextureLevels::Level &level : levels.levels)
+  {
+    entry.fullBytes += textureLevelBytes(levels.internalFormat, level.width, level.height);
+  }
+  if (!entry.tail)
+  {
+    entry.tail = std::make_shared<std::vector<MipLevel>>();
+    entry.tailBytes = 0;
+    for (const TextureLevels::Level &level : levels.levels)
+    {
+      if (std::max(level.width, level.height) > TAIL_SIZE)
+      {
+        continue;
+      }
+      MipLevel copy;
+      copy.width = level.width;
+      copy.height = level.height;
+      copy.pixels.assign(level.data, level.data + level.size);
+      entry.tail->push_back(std::move(copy));
+      entry.tailBytes += textureLevelBytes(levels.internalFormat, level.width, level.height);
+    }
+  }
+
+  //storage for the whole chain, but only the levels up to TAIL_SIZE go up now
+  int count = (int)levels.levels.size();
+  int first = count - 1;
+  while (first > 0 && std::max(levels.levels[first - 1].width, levels.levels[first - 1].height) <= TAIL_SIZE)
+  {
+    first--;
+  }
+  const TextureLevels::Level &base = levels.levels[0];
+  entry.incoming = TextureUploader::createTexture(levels.internalFormat, base.width, base.height, count);
+  //filtering across levels is what lets MIN_LOD blend a new level in
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, count > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+  setLevelClamp(entry.incoming, first, 0.0f);
+  for (int level = count - 1; level >= first; level--)
+  {
+    entry.incomingTicket = enqueueTextureLevel(uploader, entry.incoming, levels, level);
+  }
+  entry.incomingBytes = entry.fullBytes;
+  stopStreaming(entry);
+  entry.baseLevel = entry.queuedLevel = first;
+  if (first > 0)
+  {
+    entry.stream = std::move(levels);
+  }
+}
+
+void TextureCache::stopStreaming(Entry &entry)
+{
+  //levels queued but not handed to GL yet would only be written into a texture on its way out
+  if (!entry.levelTickets.empty())
+  {
+    uploader.cancel(entry.texture);
+  }
+  entry.stream = TextureLevels();
+  entry.levelTickets.clear();
+  entry.baseLevel = entry.queuedLevel = 0;
+  entry.lodFade = 0.0f;
+}
+
+bool TextureCache::uploadTail(Entry &entry)
+{
+  //only worth it when the tail is a real subset of the chain
+  if (!entry.tail || entry.tail->empty() || entry.tailBytes >= entry.fullBytes)
+  {
+    return false;
+  }
+  TextureLevels levels;
+  levels.internalFormat = entry.internalFormat;
+  levels.channels = entry.channels;
+  levels.compressed = entry.compressed;
+  levels.owner = entry.tail;
+  for (const MipLevel &level : *entry.tail)
+  {
+    levels.levels.push_back({level.width, level.height, level.pixels.data(), level.pixels.size()});
+  }
+  retire(entry.texture);
+  stopStreaming(entry);
+  entry.texture = uploadTextureLevels(uploader, levels);
+  entry.bytes = entry.tailBytes;
+  return true;
+}
+
+void TextureCache::demote(Entry &entry)
+{
+  if (!uploadTail(entry))
+  {
+    evict(entry);
+    return;
+  }
+  entry.state = State::Demoted;
+  counters.demoted++;
+}
+
+void TextureCache::evict(Entry &entry)
+{
+  if (entry.state == State::Evicted)
+  {
+    return;
+  }
+  retire(entry.texture);
+  stopStreaming(entry);
+  entry.texture = 0;
+  entry.bytes = 0;
+  entry.state = State::Evicted;
+  counters.evicted++;
+}
+
+void TextureCache::retire(unsigned int texture)
+{
+  if (texture)
+  {
+    retired.emplace_back(texture, uploader.queued());
+  }
+}
+
+size_t TextureCache::residentBytes() const
+{
+  size_t total = 0;
+  for (const Entry &entry : entries)
+  {
+    total += entry.bytes + entry.incomingBytes;
+  }
+  return total;
+}
+
+size_t TextureCache::loadingCount() const
+{
+  size_t count = 0;
+  for (const Entry &entry : entries)
+  {
+    //first loads, and reloads of evicted textures that had no small mips to fall back on
+    bool firstLoad = entry.state == State::Hashing || entry.state == State::Loading;
+    count += firstLoad || (!entry.texture && (entry.incoming || entry.loadJob.valid()));
+  }
+  return count;
+}
+
+size_t TextureCache::refiningCount() const
+{
+  size_t count = 0;
+  for (const Entry &entry : entries)
+  {
+    count += entry.state == State::Streaming && entry.lastUsedFrame + 1 >= frame;
+  }
+  return count;
+}
+
+void TextureCache::update()
+{
+  CPU_ZONE("TextureCache::update");
+  for (TextureHandle handle = 0; handle < (TextureHandle)entries.size(); handle++)
+  {
+    Entry &entry = entries[handle];
+    if (entry.state == State::Released)
+    {
+      continue;
+    }
+    if (entry.state == State::Hashing && ready(entry.hashJob))
+    {
+      entry.contentHash = entry.hashJob.get();
+      if (!entry.contentHash)
+      {
+        std::cout << "Texture load failed: " << entry.sourcePath << std::endl;
+        entry.state = State::Failed;
+        continue;
+      }
+      auto same = byContent.find(entry.contentHash);
+      if (same != byContent.end())
+      {
+        //identical contents are already loaded (or loading), share that one
+        Entry &original = resolve(same->second);
+        original.references += entry.references;
+        entry.state = State::Alias;
+        entry.aliasOf = same->second;
+        entry.contentHash = 0;
+        counters.deduplicated++;
+        continue;
+      }
+      byContent[entry.contentHash] = handle;
+      startLoad(entry);
+    }
+    if (ready(entry.loadJob))
+    {
+      finishLoad(entry, entry.loadJob.get());
+    }
+    if (entry.incoming && uploader.submitted(entry.incomingTicket))
+    {
+      retire(entry.texture);
+      entry.texture = entry.incoming;
+      entry.bytes = entry.incomingBytes;
+      entry.incoming = 0;
+      entry.incomingBytes = 0;
+      entry.state = entry.stream.ok() ? State::Streaming : State::Resident;
+    }
+  }
+  stream();
+
+  for (auto it = retired.begin(); it != retired.end();)
+  {
+    if (it->second == 0 || uploader.submitted(it->second - 1))
+    {
+      glState().deleteTextures(1, &it->first);
+      it = retired.erase(it);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+
+  enforceBudget();
+  frame++;
+}
+
+void TextureCache::stream()
+{
+  std::vector<Entry*> wanted;
+  for (Entry &entry : entries)
+  {
+    if (entry.state != State::Streaming)
+    {
+      continue;
+    }
+    //levels are submitted in the order they were queued, the base follows the last one done
+    int landed = entry.baseLevel;
+    while (!entry.levelTickets.empty() && uploader.submitted(entry.levelTickets.front().second))
+    {
+      landed = entry.levelTickets.front().first;
+      entry.levelTickets.erase(entry.levelTickets.begin());
+    }
+    if (landed != entry.baseLevel || entry.lodFade > 0.0f)
+    {
+      //MIN_LOD is relative to the base level: start from the old level and ease down
+      entry.lodFade = std::max(0.0f, entry.lodFade + (entry.baseLevel - landed) - LOD_FADE_STEP);
+      entry.baseLevel = landed;
+      setLevelClamp(entry.texture, entry.baseLevel, entry.lodFade);
+    }
+    if (entry.baseLevel == 0)
+    {
+      //everything is on the GPU, the CPU copy can go before the fade is done
+      entry.stream = TextureLevels();
+      if (entry.lodFade == 0.0f)
+      {
+        entry.state = State::Resident;
+      }
+      continue;
+    }
+    //only textures drawn lately refine, the rest keep what they have
+    if (entry.queuedLevel > 0 && entry.lastUsedFrame + 1 >= frame && entry.levelTickets.size() < MAX_LEVELS_IN_FLIGHT)
+    {
+      wanted.push_back(&entry);
+    }
+  }
+
+  //blurriest first, one level each, so textures coming into view together sharpen together
+  std::sort(wanted.begin(), wanted.end(), [](const Entry *a, const Entry *b) { return a->queuedLevel > b->queuedLevel; });
+  size_t queuedBytes = 0;
+  for (Entry *entry : wanted)
+  {
+    //checked before queueing: a base level bigger than the whole budget still gets through alone
+    if (queuedBytes >= streamBytesPerFrame)
+    {
+      break;
+    }
+    int level = --entry->queuedLevel;
+    entry->levelTickets.emplace_back(level, enqueueTextureLevel(uploader, entry->texture, entry->stream, level));
+    queuedBytes += entry->stream.levels[level].size;
+    counters.streamedLevels++;
+  }
+}
+
+void TextureCache::enforceBudget()
+{
+  size_t total = residentBytes();
+  if (total <= budgetBytes)
+  {
+    overBudget = false;
+    return;
+  }
+  //oldest first, nothing drawn this frame and nothing with an upload in flight
+  std::vector<Entry*> candidates;
+  for (Entry &entry : entries)
+  {
+    bool idle = entry.lastUsedFrame < frame && !entry.incoming;
+    if (!entry.pinned && idle && (entry.state == State::Resident || entry.state == State::Streaming || entry.state == State::Demoted))
+    {
+      candidates.push_back(&entry);
+    }
+  }
+  std::sort(candidates.begin(), candidates.end(), [](const Entry *a, const Entry *b)
+  {
+    return a->lastUsedFrame < b->lastUsedFrame;
+  });
+  //first pass drops to the small mips, the second evicts what is left
+  //textures still streaming count too, their queued levels are cancelled with the rest
+  for (int pass = 0; pass < 2 && total > budgetBytes; pass++)
+  {
+    for (Entry *entry : candidates)
+    {
+      if (total <= budgetBytes)
+      {
+        break;
+      }
+      size_t before = entry->bytes;
+      if (pass == 0 && (entry->state == State::Resident || entry->state == State::Streaming))
+      {
+        demote(*entry);
+      }
+      else if (pass == 1 && entry->state != State::Evicted)
+      {
+        evict(*entry);
+      }
+      total -= before - entry->bytes;
+    }
+  }
+  //only report going over, not every frame it stays there
+  bool over = total > budgetBytes;
+  if (over && !overBudget)
+  {
+    std::cout << "Texture cache over budget: " << total << " / " << budgetBytes << " bytes in use this frame" << std::endl;
+  }
+  overBudget = over;
+}
@@ -0,0 +1,138 @@
+#pragma once
+#include "config.h"
+#include "texture_loader.h"
+#include <unordered_map>
+
+class TextureUploader;
+
+typedef uint32_t TextureHandle;
+const TextureHandle INVALID_TEXTURE_HANDLE = 0xFFFFFFFF;
+
+/*
+* Owns every GL_TEXTURE_2D loaded from disk and keeps them under a VRAM budget.
+*  - Textures are keyed by a hash of their file contents (plus decode options),
+*    so loading the same image twice, even under another name, shares one copy.
+*  - Every texture's size is tracked. When the total goes over budget, the
+*    least recently used ones first drop to their small mips (kept on the
+*    CPU, so this costs no reload) and are only evicted completely when that
+*    is not enough. Anything used in the current frame is left alone.
+*  - Textures stream in coarse to fine. The small mips go up as soon as a
+*    load finishes; each larger level follows only while the texture is
+*    being acquired, within a per-frame byte budget. GL_TEXTURE_BASE_LEVEL
+*    is kept on the finest level the GPU has, so sampling never touches a
+*    level that is not there yet, and GL_TEXTURE_MIN_LOD fades each new
+*    level in over a few frames instead of popping.
+*  - Acquiring a demoted or evicted texture reloads it in the background and
+*    keeps handing out the small mips until the rest streams in.
+* Handles stay valid until released, but the GL name behind one can change,
+* so call acquire() every frame rather than caching it.
+*/
+class TextureCache
+{
+  public:
+    TextureCache(TextureDecodePool &pool, TextureUploader &uploader, size_t budgetBytes);
+    ~TextureCache();
+    TextureCache(const TextureCache&) = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+
+    //starts loading in the background and returns right away
+    TextureHandle load(const std::string &bakedPath, const std::string &sourcePath, const DecodeOptions &options = DecodeOptions());
+    //takes ownership of a texture made elsewhere (e.g. a texture array): counted, never evicted
+    TextureHandle adopt(unsigned int texture, size_t bytes);
+    //drops a reference, the texture is deleted with the last one
+    void release(TextureHandle handle);
+    //GL name to use this frame (0 until something is resident) and marks it as used
+    unsigned int acquire(TextureHandle handle);
+
+    //once per frame: picks up finished loads and uploads, then evicts down to the budget
+    void update();
+
+    void setBudget(size_t bytes) { budgetBytes = bytes; }
+    size_t budget() const { return budgetBytes; }
+    //bytes of mip levels handed to the uploader per update() for refining textures in use
+    void setStreamBudget(size_t bytes) { streamBytesPerFrame = bytes; }
+    //VRAM held by every texture the cache owns, including uploads in flight
+    size_t residentBytes() const;
+    //textures with nothing to draw yet: still hashing, decoding or uploading their small mips
+    size_t loadingCount() const;
+    //textures drawn lately that still have finer levels on the way (or fading in)
+    size_t refiningCount() const;
+
+    struct Stats
+    {
+      uint64_t deduplicated = 0;
+      uint64_t demoted = 0;
+      uint64_t evicted = 0;
+      uint64_t reloaded = 0;
+      uint64_t streamedLevels = 0;
+    };
+    const Stats &stats() const { return counters; }
+
+  private:
+    enum class State { Hashing, Loading, Streaming, Resident, Demoted, Evicted, Failed, Alias, Released };
+
+    struct Entry
+    {
+      State state = State::Hashing;
+      std::string pathKey;
+      std::string bakedPath;
+      std::string sourcePath;
+      DecodeOptions options;
+      uint64_t contentHash = 0;
+      TextureHandle aliasOf = INVALID_TEXTURE_HANDLE;
+      int references = 1;
+      bool pinned = false;
+      uint64_t lastUsedFrame = 0;
+
+      unsigned int texture = 0;
+      size_t bytes = 0;
+      //full chain texture being filled, swapped in for texture once its small mips are submitted
+      unsigned int incoming = 0;
+      size_t incomingBytes = 0;
+      uint64_t incomingTicket = 0;
+
+      std::future<uint64_t> hashJob;
+      std::future<TextureLevels> loadJob;
+
+      //the smallest levels, kept on the CPU for demotion
+      GLenum internalFormat = 0;
+      int channels = 0;
+      bool compressed = false;
+      std::shared_ptr<std::vector<MipLevel>> tail;
+      size_t tailBytes = 0;
+      size_t fullBytes = 0;
+
+      //while streaming: the whole chain on the CPU, the finest level sampled (GL_TEXTURE_BASE_LEVEL),
+      //the finest level queued, and the tickets of the levels queued but not yet submitted
+      TextureLevels stream;
+      int baseLevel = 0;
+      int queuedLevel = 0;
+      std::vector<std::pair<int, uint64_t>> levelTickets;
+      float lodFade = 0.0f;
+    };
+
+    Entry &resolve(TextureHandle handle);
+    void startLoad(Entry &entry);
+    void finishLoad(Entry &entry, TextureLevels &&levels);
+    //puts just the small mips on the GPU, false when there are none or they are the whole chain
+    bool uploadTail(Entry &entry);
+    void demote(Entry &entry);
+    void evict(Entry &entry);
+    void stream();
+    void stopStreaming(Entry &entry);
+    void enforceBudget();
+    //deletes a texture once the uploader is done writing into it
+    void retire(unsigned int texture);
+
+    TextureDecodePool &pool;
+    TextureUploader &uploader;
+    size_t budgetBytes;
+    size_t streamBytesPerFrame = 4 * 1024 * 1024;
+    uint64_t frame = 1;
+    bool overBudget = false;
+    std::vector<Entry> entries;
+    std::unordered_map<std::string, TextureHandle> byPath;
+    std::unordered_map<uint64_t, TextureHandle> byContent;
+    std::vector<std::pair<unsigned int, uint64_t>> retired;
+    Stats counters;
+};
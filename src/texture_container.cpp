@@ -0,0 +1,78 @@
+#include "texture_container.h"
+#include "texture_formats.h"
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//bytes a level of the header's format must hold, tightly packed as the uploads read it
+static size_t expectedLevelSize(const TextureContainerHeader &header, const TextureContainerLevel &level)
+{
+  if (header.compressed)
+  {
+    BlockFormat format = blockFormatForInternalFormat(header.internalFormat);
+    return format == BlockFormat::None ? 0 : compressedLevelSize(format, level.width, level.height);
+  }
+  return (size_t)level.width * level.height * header.channels;
+}
+
+std::shared_ptr<TextureContainer> TextureContainer::open(const std::string &path)
+{
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    return nullptr;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(TextureContainerHeader))
+  {
+    close(fd);
+    return nullptr;
+  }
+  void *mapped = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  //the mapping keeps the file alive on its own
+  close(fd);
+  if (mapped == MAP_FAILED)
+  {
+    return nullptr;
+  }
+  std::shared_ptr<TextureContainer> container(new TextureContainer());
+  container->data = (const unsigned char*)mapped;
+  container->size = info.st_size;
+
+  const TextureContainerHeader &header = container->header();
+  size_t tableEnd = sizeof(TextureContainerHeader) + (size_t)header.levelCount * sizeof(TextureContainerLevel);
+  if (header.magic != TEXTURE_CONTAINER_MAGIC || header.version != TEXTURE_CONTAINER_VERSION
+      || header.levelCount == 0 || tableEnd > container->size)
+  {
+    std::cout << "ERROR::TEXTURE_CONTAINER::BAD_HEADER " << path << std::endl;
+    return nullptr;
+  }
+  for (uint32_t i = 0; i < header.levelCount; i++)
+  {
+    const TextureContainerLevel &level = container->level(i);
+    if (level.offset + level.size > container->size)
+    {
+      std::cout << "ERROR::TEXTURE_CONTAINER::TRUNCATED " << path << std::endl;
+      return nullptr;
+    }
+    //a short level would have the upload read past its data
+    if (level.size != expectedLevelSize(header, level))
+    {
+      std::cout << "ERROR::TEXTURE_CONTAINER::BAD_LEVEL_SIZE " << path << std::endl;
+      return nullptr;
+    }
+  }
+  //levels are uploaded front to back right after opening
+  madvise(mapped, info.st_size, MADV_WILLNEED);
+  return container;
+}
+
+TextureContainer::~TextureContainer()
+{
+  if (data)
+  {
+    munmap((void*)data, size);
+  }
+}
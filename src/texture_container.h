@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/*
+* Baked texture container (.ctex) written by Cals_texc.
+* Layout: header, one TextureContainerLevel per mip, then the level data.
+* Every level is already flipped and tightly packed in the exact layout
+* glTexSubImage2D / glCompressedTexSubImage2D expect, starting on a
+* 16 byte boundary. Integers are little endian.
+*/
+const uint32_t TEXTURE_CONTAINER_MAGIC = 0x58455443; //"CTEX"
+const uint32_t TEXTURE_CONTAINER_VERSION = 1;
+
+struct TextureContainerHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t width;
+  uint32_t height;
+  uint32_t levelCount;
+  uint32_t channels;
+  uint32_t internalFormat; //GL enum
+  uint32_t compressed; //1 if levels are compressed blocks
+};
+
+struct TextureContainerLevel
+{
+  uint32_t width;
+  uint32_t height;
+  uint64_t offset; //from the start of the file
+  uint64_t size;
+};
+
+/*
+* Read only view of a .ctex file. The file is mmapped, so nothing is read
+* until a level is touched and the pages come straight from the page cache.
+*/
+class TextureContainer
+{
+  public:
+    //returns nullptr if the file is missing or not a valid container
+    static std::shared_ptr<TextureContainer> open(const std::string &path);
+    ~TextureContainer();
+    TextureContainer(const TextureContainer&) = delete;
+    TextureContainer& operator=(const TextureContainer&) = delete;
+
+    const TextureContainerHeader &header() const { return *(const TextureContainerHeader*)data; }
+    const TextureContainerLevel &level(uint32_t index) const
+    {
+      return ((const TextureContainerLevel*)(data + sizeof(TextureContainerHeader)))[index];
+    }
+    const unsigned char *levelData(uint32_t index) const { return data + level(index).offset; }
+
+  private:
+    TextureContainer() = default;
+    const unsigned char *data = nullptr;
+    size_t size = 0;
+};
@@ -0,0 +1,63 @@
+#pragma once
+#include <glad/glad.h>
+#include "bcn_encoder.h"
+
+/*
+* GL enums for the texture formats we store, shared by the renderer and
+* Cals_texc (which only needs the enums, not a context).
+*/
+//EXT_texture_compression_s3tc
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+//GL 4.2 / ARB_texture_compression_bptc
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+
+//sized internal format matching a channel count (1 = GL_R8 ... 4 = GL_RGBA8)
+inline GLenum internalFormatForChannels(int channels)
+{
+  switch (channels)
+  {
+    case 1: return GL_R8;
+    case 2: return GL_RG8;
+    case 4: return GL_RGBA8;
+    default: return GL_RGB8;
+  }
+}
+
+inline GLenum internalFormatForBlockFormat(BlockFormat format)
+{
+  switch (format)
+  {
+    case BlockFormat::BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case BlockFormat::BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case BlockFormat::BC7: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+    default: return 0;
+  }
+}
+
+inline BlockFormat blockFormatForInternalFormat(GLenum internalFormat)
+{
+  switch (internalFormat)
+  {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: return BlockFormat::BC1;
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: return BlockFormat::BC3;
+    case GL_COMPRESSED_RGBA_BPTC_UNORM: return BlockFormat::BC7;
+    default: return BlockFormat::None;
+  }
+}
+
+//VRAM taken by one level; RGB8 is counted as 4 bytes per texel since drivers pad it
+inline size_t textureLevelBytes(GLenum internalFormat, int width, int height)
+{
+  BlockFormat blockFormat = blockFormatForInternalFormat(internalFormat);
+  if (blockFormat != BlockFormat::None)
+  {
+    return compressedLevelSize(blockFormat, width, height);
+  }
+  size_t texelBytes = internalFormat == GL_R8 ? 1 : internalFormat == GL_RG8 ? 2 : 4;
+  return (size_t)width * height * texelBytes;
+}
@@ -0,0 +1,275 @@
+#include "texture_loader.h"
+#include "texture_upload.h"
+#include "gl_ext.h"
+#include "cpu_profiler.h"
+#include <cstdlib>
+#include <cstring>
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+void DecodedImage::stbiFree(void* data)
+{
+  stbi_image_free(data);
+}
+
+DecodedImage decodeImage(const std::string &path, const DecodeOptions &options, ThreadPool *encodePool)
+{
+  CPU_ZONE("decodeImage");
+  DecodedImage image;
+  image.path = path;
+  //stb keeps a thread local override next to the global flag, so each job sets its own
+  stbi_set_flip_vertically_on_load_thread(options.flipVertically);
+  int fileChannels = 0;
+  {
+    CPU_ZONE("stbi_load");
+    image.pixels.reset(stbi_load(path.c_str(), &image.width, &image.height, &fileChannels, options.desiredChannels));
+  }
+  image.channels = options.desiredChannels ? options.desiredChannels : fileChannels;
+  if (!image.ok())
+  {
+    return image;
+  }
+  if (options.width && options.height && (options.width != image.width || options.height != image.height))
+  {
+    MipLevel resized = resizeImage(image.pixels.get(), image.width, image.height, image.channels, options.width, options.height);
+    //stbi_image_free is plain free(), so a malloc'd buffer can take the stb one's place
+    unsigned char *pixels = (unsigned char*)malloc(resized.pixels.size());
+    memcpy(pixels, resized.pixels.data(), resized.pixels.size());
+    image.pixels.reset(pixels);
+    image.width = resized.width;
+    image.height = resized.height;
+  }
+  const TextureCompression &compression = options.compression;
+  if (compression.format == BlockFormat::None)
+  {
+    return image;
+  }
+  //the GL cannot build mips for compressed textures, so the chain is made here before encoding
+  std::vector<MipLevel> chain = buildMipChain(image.pixels.get(), image.width, image.height, image.channels);
+  image.blockFormat = compression.format;
+  image.compressedLevels.resize(chain.size() + 1);
+  CPU_ZONE("encodeBlocks");
+  for (size_t i = 0; i < image.compressedLevels.size(); i++)
+  {
+    MipLevel &level = image.compressedLevels[i];
+    level.width = i == 0 ? image.width : chain[i - 1].width;
+    level.height = i == 0 ? image.height : chain[i - 1].height;
+    const unsigned char *source = i == 0 ? image.pixels.get() : chain[i - 1].pixels.data();
+    level.pixels = encodeBlocks(source, level.width, level.height, image.channels, compression, encodePool);
+  }
+  return image;
+}
+
+TextureDecodePool::TextureDecodePool(unsigned int threadCount) : pool(threadCount), encodePool(threadCount)
+{
+}
+
+std::future<DecodedImage> TextureDecodePool::decode(const std::string &path, const DecodeOptions &options)
+{
+  ThreadPool *encoder = &encodePool;
+  return pool.submit([path, options, encoder]()
+  {
+    return decodeImage(path, options, encoder);
+  });
+}
+
+TextureLevels loadTextureLevels(const std::string &bakedPath, const std::string &sourcePath,
+                                const DecodeOptions &options, ThreadPool *encodePool)
+{
+  CPU_ZONE("loadTextureLevels");
+  TextureLevels result;
+  result.path = sourcePath;
+  std::shared_ptr<TextureContainer> baked = TextureContainer::open(bakedPath);
+  //support flags are plain ints set once at startup, safe to read from a worker
+  if (baked && textureFormatSupported(baked->header().internalFormat))
+  {
+    const TextureContainerHeader &header = baked->header();
+    result.internalFormat = header.internalFormat;
+    result.channels = header.channels;
+    result.compressed = header.compressed != 0;
+    for (uint32_t i = 0; i < header.levelCount; i++)
+    {
+      const TextureContainerLevel &level = baked->level(i);
+      result.levels.push_back({(int)level.width, (int)level.height, baked->levelData(i), (size_t)level.size});
+    }
+    result.owner = baked;
+    return result;
+  }
+
+  DecodeOptions decodeOptions = options;
+  if (!textureFormatSupported(internalFormatForBlockFormat(options.compression.format)))
+  {
+    decodeOptions.compression = TextureCompression();
+  }
+  auto image = std::make_shared<DecodedImage>(decodeImage(sourcePath, decodeOptions, encodePool));
+  if (!image->ok())
+  {
+    std::cout << "Texture load failed: " << sourcePath << std::endl;
+    return result;
+  }
+  result.channels = image->channels;
+  if (image->blockFormat != BlockFormat::None)
+  {
+    result.internalFormat = internalFormatForBlockFormat(image->blockFormat);
+    result.compressed = true;
+    for (const MipLevel &level : image->compressedLevels)
+    {
+      result.levels.push_back({level.width, level.height, level.pixels.data(), level.pixels.size()});
+    }
+    result.owner = image;
+    return result;
+  }
+  //CPU mips so every level has CPU data (e.g. for a cache that keeps the small ones around)
+  auto chain = std::make_shared<std::vector<MipLevel>>(buildMipChain(image->pixels.get(), image->width, image->height, image->channels));
+  result.internalFormat = internalFormatForChannels(image->channels);
+  result.levels.push_back({image->width, image->height, image->pixels.get(), (size_t)image->width * image->height * image->channels});
+  for (const MipLevel &level : *chain)
+  {
+    result.levels.push_back({level.width, level.height, level.pixels.data(), level.pixels.size()});
+  }
+  result.owner = std::make_shared<std::pair<std::shared_ptr<DecodedImage>, std::shared_ptr<std::vector<MipLevel>>>>(image, chain);
+  return result;
+}
+
+std::future<TextureLevels> TextureDecodePool::loadLevels(const std::string &bakedPath, const std::string &sourcePath,
+                                                         const DecodeOptions &options)
+{
+  ThreadPool *encoder = &encodePool;
+  return pool.submit([bakedPath, sourcePath, options, encoder]()
+  {
+    return loadTextureLevels(bakedPath, sourcePath, options, encoder);
+  });
+}
+
+GLenum formatForChannels(int channels)
+{
+  switch (channels)
+  {
+    case 1: return GL_RED;
+    case 2: return GL_RG;
+    case 4: return GL_RGBA;
+    default: return GL_RGB;
+  }
+}
+
+unsigned int uploadTexture2D(TextureUploader &uploader, DecodedImage &&image)
+{
+  if (!image.ok())
+  {
+    std::cout << "Texture load failed: " << image.path << std::endl;
+    return 0;
+  }
+  GLenum compressedFormat = internalFormatForBlockFormat(image.blockFormat);
+  if (compressedFormat && textureFormatSupported(compressedFormat))
+  {
+    int levels = (int)image.compressedLevels.size();
+    unsigned int texture = TextureUploader::createTexture(compressedFormat, image.width, image.height, levels);
+    auto owner = std::make_shared<DecodedImage>(std::move(image));
+    for (int i = 0; i < levels; i++)
+    {
+      const MipLevel &level = owner->compressedLevels[i];
+      uploader.enqueueCompressed(texture, i, level.width, level.height, compressedFormat, level.pixels.data(), owner);
+    }
+    return texture;
+  }
+  if (compressedFormat)
+  {
+    std::cout << "Texture format not supported by the driver, uploading uncompressed: " << image.path << std::endl;
+  }
+  int levels = TextureUploader::mipLevelCount(image.width, image.height);
+  unsigned int texture = TextureUploader::createTexture(internalFormatForChannels(image.channels), image.width, image.height, levels);
+  //the uploader copies out of the stb buffer band by band, so it keeps the image alive until then
+  auto owner = std::make_shared<DecodedImage>(std::move(image));
+  uploader.enqueue(texture, 0, owner->width, owner->height, owner->channels, owner->pixels.get(), owner, true);
+  return texture;
+}
+
+uint64_t enqueueTextureLevel(TextureUploader &uploader, unsigned int texture, const TextureLevels &levels, int level)
+{
+  const TextureLevels::Level &source = levels.levels[level];
+  if (levels.compressed)
+  {
+    return uploader.enqueueCompressed(texture, level, source.width, source.height, levels.internalFormat, source.data, levels.owner);
+  }
+  return uploader.enqueue(texture, level, source.width, source.height, levels.channels, source.data, levels.owner);
+}
+
+unsigned int uploadTextureLevels(TextureUploader &uploader, const TextureLevels &levels, int firstLevel, uint64_t *ticket)
+{
+  const TextureLevels::Level &base = levels.levels[firstLevel];
+  int count = (int)levels.levels.size() - firstLevel;
+  unsigned int texture = TextureUploader::createTexture(levels.internalFormat, base.width, base.height, count);
+  uint64_t last = 0;
+  for (int i = 0; i < count; i++)
+  {
+    const TextureLevels::Level &level = levels.levels[firstLevel + i];
+    if (levels.compressed)
+    {
+      last = uploader.enqueueCompressed(texture, i, level.width, level.height, levels.internalFormat, level.data, levels.owner);
+    }
+    else
+    {
+      last = uploader.enqueue(texture, i, level.width, level.height, levels.channels, level.data, levels.owner);
+    }
+  }
+  if (ticket)
+  {
+    *ticket = last;
+  }
+  return texture;
+}
+
+unsigned int uploadTextureContainer(TextureUploader &uploader, const std::shared_ptr<TextureContainer> &container)
+{
+  const TextureContainerHeader &header = container->header();
+  if (!textureFormatSupported(header.internalFormat))
+  {
+    return 0;
+  }
+  unsigned int texture = TextureUploader::createTexture(header.internalFormat, header.width, header.height, header.levelCount);
+  for (uint32_t i = 0; i < header.levelCount; i++)
+  {
+    const TextureContainerLevel &level = container->level(i);
+    if (header.compressed)
+    {
+      uploader.enqueueCompressed(texture, i, level.width, level.height, header.internalFormat, container->levelData(i), container);
+    }
+    else
+    {
+      uploader.enqueue(texture, i, level.width, level.height, header.channels, container->levelData(i), container);
+    }
+  }
+  return texture;
+}
+
+PendingTexture requestTexture(TextureDecodePool &pool, const std::string &bakedPath, const std::string &sourcePath,
+                              const DecodeOptions &options)
+{
+  PendingTexture texture;
+  texture.sourcePath = sourcePath;
+  texture.options = options;
+  texture.baked = TextureContainer::open(bakedPath);
+  if (!texture.baked)
+  {
+    texture.decoded = pool.decode(sourcePath, options);
+  }
+  return texture;
+}
+
+unsigned int uploadTexture(TextureUploader &uploader, PendingTexture &&texture)
+{
+  if (texture.baked)
+  {
+    unsigned int id = uploadTextureContainer(uploader, texture.baked);
+    if (id)
+    {
+      return id;
+    }
+    //baked for a format this driver lacks, decode the source instead (slow path, logged)
+    std::cout << "Baked texture format not supported by the driver, decoding " << texture.sourcePath << std::endl;
+    DecodeOptions options = texture.options;
+    options.compression = TextureCompression();
+    return uploadTexture2D(uploader, decodeImage(texture.sourcePath, options));
+  }
+  return uploadTexture2D(uploader, texture.decoded.get());
+}
@@ -0,0 +1,139 @@
+#pragma once
+#include "config.h"
+#include "thread_pool.h"
+#include "texture_container.h"
+#include "texture_formats.h"
+#include "mipmap.h"
+
+/*
+* Pixels decoded by stb_image on a worker thread.
+* Owns the stb allocation, so it is freed whenever the image goes away.
+*/
+struct DecodedImage
+{
+  std::string path;
+  int width = 0;
+  int height = 0;
+  int channels = 0;
+  std::unique_ptr<unsigned char, void (*)(void*)> pixels{nullptr, stbiFree};
+  //filled when the job also block compressed the image: every mip level, base first
+  //the raw pixels stay around in case the driver turns out not to support the format
+  BlockFormat blockFormat = BlockFormat::None;
+  std::vector<MipLevel> compressedLevels;
+
+  bool ok() const { return pixels != nullptr; }
+  static void stbiFree(void* data);
+};
+
+//what a decode job does after stbi_load
+struct DecodeOptions
+{
+  bool flipVertically = true;
+  //0 keeps whatever the file has
+  int desiredChannels = 0;
+  //0x0 keeps the file's size, anything else is resampled (e.g. to fit a texture array)
+  int width = 0;
+  int height = 0;
+  TextureCompression compression;
+};
+
+//decodes (and optionally resizes and block compresses) on the calling thread
+//encodePool spreads the block compression, it must not be the pool running this call
+DecodedImage decodeImage(const std::string &path, const DecodeOptions &options, ThreadPool *encodePool = nullptr);
+
+/*
+* Every mip level of a texture in CPU memory, in the layout the uploader
+* wants. Levels point into a baked container or into decoded/encoded
+* buffers; owner keeps whichever it is alive.
+*/
+struct TextureLevels
+{
+  struct Level
+  {
+    int width;
+    int height;
+    const unsigned char *data;
+    size_t size;
+  };
+  std::string path;
+  GLenum internalFormat = 0;
+  int channels = 0;
+  bool compressed = false;
+  std::vector<Level> levels;
+  std::shared_ptr<const void> owner;
+
+  bool ok() const { return !levels.empty(); }
+};
+
+//full chain from a baked container when one exists (and the driver can sample it),
+//otherwise decoded and, for uncompressed textures too, mipmapped on the CPU
+TextureLevels loadTextureLevels(const std::string &bakedPath, const std::string &sourcePath,
+                                const DecodeOptions &options, ThreadPool *encodePool = nullptr);
+
+/*
+* Decodes image files in parallel so startup costs the slowest image rather
+* than the sum of all of them. Only decoding happens here; handing the
+* pixels to GL stays on the thread that owns the context (uploadTexture2D).
+* Block compression runs on a second pool: decode jobs wait on it, and a
+* pool waiting on its own jobs could deadlock.
+*/
+class TextureDecodePool
+{
+  public:
+    explicit TextureDecodePool(unsigned int threadCount = 0);
+
+    //flip is per job, stb's global flag is never touched
+    std::future<DecodedImage> decode(const std::string &path, const DecodeOptions &options = DecodeOptions());
+    //loadTextureLevels on the pool
+    std::future<TextureLevels> loadLevels(const std::string &bakedPath, const std::string &sourcePath,
+                                          const DecodeOptions &options = DecodeOptions());
+
+    //the decode workers, for other file work that should stay off the render thread
+    ThreadPool &threads() { return pool; }
+
+  private:
+    ThreadPool pool;
+    ThreadPool encodePool;
+};
+
+class TextureUploader;
+
+//GL format matching a channel count (1 = GL_RED ... 4 = GL_RGBA)
+GLenum formatForChannels(int channels);
+
+//creates an immutable GL_TEXTURE_2D for the image and queues its pixels on the uploader,
+//the texture is complete (mips included) once the uploader has drained the queue
+//must be called on the GL thread, returns 0 and logs if the image failed to decode
+unsigned int uploadTexture2D(TextureUploader &uploader, DecodedImage &&image);
+
+//queues levels.levels[level] into the same level of texture, which must hold the whole chain
+//returns the uploader ticket for it
+uint64_t enqueueTextureLevel(TextureUploader &uploader, unsigned int texture, const TextureLevels &levels, int level);
+
+//creates a texture holding levels [firstLevel, end) (firstLevel becomes its level 0) and queues them,
+//ticket receives the uploader ticket of the last level so callers know when it is complete
+unsigned int uploadTextureLevels(TextureUploader &uploader, const TextureLevels &levels, int firstLevel = 0, uint64_t *ticket = nullptr);
+
+//uploads every level of a baked container as is: no decode, no flip, no glGenerateMipmap
+//returns 0 if the driver cannot sample the container's format
+unsigned int uploadTextureContainer(TextureUploader &uploader, const std::shared_ptr<TextureContainer> &container);
+
+/*
+* A texture on its way in: either a baked container that is already mapped,
+* or a decode running on the pool when no baked file exists.
+* The source is remembered in case the baked format turns out to be unsupported.
+*/
+struct PendingTexture
+{
+  std::shared_ptr<TextureContainer> baked;
+  std::future<DecodedImage> decoded;
+  std::string sourcePath;
+  DecodeOptions options;
+};
+
+//prefers bakedPath (a .ctex from Cals_texc), falls back to decoding sourcePath
+//options only apply to the decode path, baked files keep the format they were baked with
+PendingTexture requestTexture(TextureDecodePool &pool, const std::string &bakedPath, const std::string &sourcePath,
+                              const DecodeOptions &options = DecodeOptions());
+//blocks on the decode if one is still running
+unsigned int uploadTexture(TextureUploader &uploader, PendingTexture &&texture);
@@ -0,0 +1,297 @@
+#include "texture_upload.h"
+#include "gl_state.h"
+#include "gl_ext.h"
+#include "cpu_profiler.h"
+#include "texture_loader.h"
+#include "texture_formats.h"
+#include <algorithm>
+#include <cstring>
+
+TextureUploader::TextureUploader(unsigned int slotCount, size_t slotBytes) : slots(slotCount), slotSize(slotBytes)
+{
+  persistent = GLEXT_ARB_buffer_storage != 0;
+  for (Slot &slot : slots)
+  {
+    glGenBuffers(1, &slot.buffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+    if (persistent)
+    {
+      GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+      glBufferStorage(GL_PIXEL_UNPACK_BUFFER, slotSize, NULL, flags);
+      slot.mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, slotSize, flags);
+    }
+    else
+    {
+      glBufferData(GL_PIXEL_UNPACK_BUFFER, slotSize, NULL, GL_STREAM_DRAW);
+    }
+  }
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+TextureUploader::~TextureUploader()
+{
+  for (Slot &slot : slots)
+  {
+    if (slot.fence)
+    {
+      glDeleteSync(slot.fence);
+    }
+    if (slot.mapped)
+    {
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+      glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+    glDeleteBuffers(1, &slot.buffer);
+  }
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+int TextureUploader::mipLevelCount(int width, int height)
+{
+  int levels = 1;
+  int size = std::max(width, height);
+  while (size > 1)
+  {
+    size >>= 1;
+    levels++;
+  }
+  return levels;
+}
+
+unsigned int TextureUploader::createTexture(GLenum internalFormat, int width, int height, int levels)
+{
+  unsigned int texture;
+  glGenTextures(1, &texture);
+  glState().bindTexture(GL_TEXTURE_2D, texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  if (GLEXT_ARB_texture_storage)
+  {
+    glTexStorage2D(GL_TEXTURE_2D, levels, internalFormat, width, height);
+  }
+  else
+  {
+    //same end result with mutable storage, one level at a time
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    BlockFormat blockFormat = blockFormatForInternalFormat(internalFormat);
+    for (int level = 0; level < levels; level++)
+    {
+      int levelWidth = std::max(1, width >> level);
+      int levelHeight = std::max(1, height >> level);
+      if (blockFormat != BlockFormat::None)
+      {
+        GLsizei size = (GLsizei)compressedLevelSize(blockFormat, levelWidth, levelHeight);
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, internalFormat, levelWidth, levelHeight, 0, size, NULL);
+      }
+      else
+      {
+        glTexImage2D(GL_TEXTURE_2D, level, internalFormat, levelWidth, levelHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+      }
+    }
+  }
+  return texture;
+}
+
+unsigned int TextureUploader::createTextureArray(GLenum internalFormat, int width, int height, int layers, int levels)
+{
+  unsigned int texture;
+  glGenTextures(1, &texture);
+  glState().bindTexture(GL_TEXTURE_2D_ARRAY, texture);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  if (GLEXT_ARB_texture_storage)
+  {
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, internalFormat, width, height, layers);
+  }
+  else
+  {
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    BlockFormat blockFormat = blockFormatForInternalFormat(internalFormat);
+    for (int level = 0; level < levels; level++)
+    {
+      int levelWidth = std::max(1, width >> level);
+      int levelHeight = std::max(1, height >> level);
+      if (blockFormat != BlockFormat::None)
+      {
+        GLsizei size = (GLsizei)(compressedLevelSize(blockFormat, levelWidth, levelHeight) * layers);
+        glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, internalFormat, levelWidth, levelHeight, layers, 0, size, NULL);
+      }
+      else
+      {
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, level, internalFormat, levelWidth, levelHeight, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+      }
+    }
+  }
+  return texture;
+}
+
+uint64_t TextureUploader::enqueue(unsigned int texture, int level, int width, int height, int channels,
+                              const unsigned char *pixels, std::shared_ptr<const void> owner, bool generateMips, int layer)
+{
+  pending.push_back({texture, level, width, height, channels, pixels, std::move(owner), generateMips, 0, layer, 0});
+  return queuedUploads++;
+}
+
+uint64_t TextureUploader::enqueueCompressed(unsigned int texture, int level, int width, int height, GLenum compressedFormat,
+                                        const unsigned char *blocks, std::shared_ptr<const void> owner, int layer)
+{
+  pending.push_back({texture, level, width, height, 0, blocks, std::move(owner), false, compressedFormat, layer, 0});
+  return queuedUploads++;
+}
+
+void TextureUploader::cancel(unsigned int texture)
+{
+  //marked rather than erased, tickets are counted off the front of the queue in order
+  for (Upload &upload : pending)
+  {
+    if (upload.texture == texture)
+    {
+      upload.texture = 0;
+      upload.owner.reset();
+    }
+  }
+}
+
+bool TextureUploader::slotReady(Slot &slot, bool wait)
+{
+  if (!slot.fence)
+  {
+    return true;
+  }
+  GLenum result = glClientWaitSync(slot.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? 1000000000 : 0);
+  while (wait && result == GL_TIMEOUT_EXPIRED)
+  {
+    result = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+  }
+  if (result == GL_TIMEOUT_EXPIRED)
+  {
+    return false;
+  }
+  glDeleteSync(slot.fence);
+  slot.fence = 0;
+  return true;
+}
+
+size_t TextureUploader::pump(size_t byteBudget, bool wait)
+{
+  size_t sent = 0;
+  if (pending.empty())
+  {
+    return 0;
+  }
+  //uploads bind on the active unit through the state cache, so the frame rebinds what it needs
+  //rows are tightly packed; the caller's unpack alignment is put back once the uploads are in
+  GLint previousAlignment = 4;
+  glGetIntegerv(GL_UNPACK_ALIGNMENT, &previousAlignment);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  while (!pending.empty() && sent < byteBudget)
+  {
+    if (!pending.front().texture)
+    {
+      pending.pop_front();
+      completedUploads++;
+      continue;
+    }
+    Slot &slot = slots[nextSlot];
+    if (!slotReady(slot, wait))
+    {
+      //the oldest slot is still in flight, so are the newer ones; try again next frame
+      break;
+    }
+    Upload &upload = pending.front();
+    //compressed levels go up in rows of 4x4 blocks, the GL only accepts whole blocks
+    BlockFormat blockFormat = blockFormatForInternalFormat(upload.compressedFormat);
+    size_t rowBytes = (size_t)upload.width * upload.channels;
+    int rowCount = upload.height;
+    if (upload.compressedFormat)
+    {
+      rowBytes = compressedLevelSize(blockFormat, upload.width, 1);
+      rowCount = (upload.height + 3) / 4;
+    }
+    int rows = (int)std::min<size_t>(rowCount - upload.nextRow, std::max<size_t>(1, slotSize / rowBytes));
+    size_t bytes = rowBytes * rows;
+    if (bytes > slotSize)
+    {
+      std::cout << "ERROR::TEXTURE_UPLOAD::ROW_LARGER_THAN_SLOT" << std::endl;
+      pending.pop_front();
+      completedUploads++;
+      continue;
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+    const unsigned char *source = upload.pixels + rowBytes * upload.nextRow;
+    if (persistent)
+    {
+      memcpy(slot.mapped, source, bytes);
+    }
+    else
+    {
+      GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+      void *mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, flags);
+      memcpy(mapped, source, bytes);
+      glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+    GLenum target = upload.layer < 0 ? GL_TEXTURE_2D : GL_TEXTURE_2D_ARRAY;
+    glState().bindTexture(target, upload.texture);
+    //with a PBO bound the last argument is an offset into it, not a client pointer
+    if (upload.compressedFormat)
+    {
+      int y = upload.nextRow * 4;
+      int height = std::min(rows * 4, upload.height - y);
+      if (upload.layer < 0)
+      {
+        glCompressedTexSubImage2D(target, upload.level, 0, y, upload.width, height, upload.compressedFormat, (GLsizei)bytes, (void*)0);
+      }
+      else
+      {
+        glCompressedTexSubImage3D(target, upload.level, 0, y, upload.layer, upload.width, height, 1, upload.compressedFormat, (GLsizei)bytes, (void*)0);
+      }
+    }
+    else
+    {
+      GLenum format = formatForChannels(upload.channels);
+      if (upload.layer < 0)
+      {
+        glTexSubImage2D(target, upload.level, 0, upload.nextRow, upload.width, rows, format, GL_UNSIGNED_BYTE, (void*)0);
+      }
+      else
+      {
+        glTexSubImage3D(target, upload.level, 0, upload.nextRow, upload.layer, upload.width, rows, 1, format, GL_UNSIGNED_BYTE, (void*)0);
+      }
+    }
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    nextSlot = (nextSlot + 1) % slots.size();
+
+    sent += bytes;
+    upload.nextRow += rows;
+    if (upload.nextRow >= rowCount)
+    {
+      if (upload.generateMips)
+      {
+        glGenerateMipmap(target);
+      }
+      pending.pop_front();
+      completedUploads++;
+    }
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, previousAlignment);
+  uploadedBytes += sent;
+  return sent;
+}
+
+size_t TextureUploader::update(size_t byteBudget)
+{
+  CPU_ZONE("TextureUploader::update");
+  return pump(byteBudget, false);
+}
+
+void TextureUploader::finish()
+{
+  CPU_ZONE("TextureUploader::finish");
+  pump((size_t)-1, true);
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include "config.h"
+#include <deque>
+#include <memory>
+#include <vector>
+
+/*
+* Streams pixels into textures through a ring of pixel unpack buffers.
+* Each ring slot is a PBO guarded by a fence: a slot is only written again
+* once the GPU has consumed the previous glTexSubImage2D from it, which is
+* checked without blocking. Uploads larger than a slot go through in bands
+* of rows, so a frame never has to wait on one huge copy.
+* With ARB_buffer_storage the slots are mapped once and stay mapped,
+* otherwise every band maps its slot unsynchronized (the fence already
+* guarantees the GPU is done with it).
+*/
+class TextureUploader
+{
+  public:
+    explicit TextureUploader(unsigned int slotCount = 3, size_t slotBytes = 4 * 1024 * 1024);
+    ~TextureUploader();
+    TextureUploader(const TextureUploader&) = delete;
+    TextureUploader& operator=(const TextureUploader&) = delete;
+
+    //allocates an immutable GL_TEXTURE_2D (glTexStorage2D when available) with
+    //the usual repeat/linear parameters and no contents yet, compressed formats work too
+    static unsigned int createTexture(GLenum internalFormat, int width, int height, int levels);
+    //same for a GL_TEXTURE_2D_ARRAY with the given number of layers
+    static unsigned int createTextureArray(GLenum internalFormat, int width, int height, int layers, int levels);
+    //number of levels in a full mip chain
+    static int mipLevelCount(int width, int height);
+
+    //queues a tightly packed level for upload, owner keeps the pixels alive until it is done
+    //with generateMips the rest of the chain is built on the GPU once the last row is in
+    //layer >= 0 targets that layer of a GL_TEXTURE_2D_ARRAY instead of a GL_TEXTURE_2D
+    //returns a ticket for submitted()
+    uint64_t enqueue(unsigned int texture, int level, int width, int height, int channels,
+                 const unsigned char *pixels, std::shared_ptr<const void> owner, bool generateMips = false, int layer = -1);
+    //same for a block compressed level (compressedFormat is the GL internal format),
+    //bands are whole rows of 4x4 blocks
+    uint64_t enqueueCompressed(unsigned int texture, int level, int width, int height, GLenum compressedFormat,
+                           const unsigned char *blocks, std::shared_ptr<const void> owner, int layer = -1);
+
+    //drops every queued upload into texture that has not been handed to GL yet (it is being
+    //deleted or replaced); their tickets still count as submitted once the queue gets to them
+    void cancel(unsigned int texture);
+
+    //pushes queued rows into free slots until the budget is spent or every slot is busy
+    //never waits on the GPU, returns the bytes handed to GL
+    size_t update(size_t byteBudget = (size_t)-1);
+    //drains the queue, waiting on fences as needed (startup / loading screens only)
+    void finish();
+
+    bool idle() const { return pending.empty(); }
+    //true once every row of that upload has been handed to GL; GL orders commands,
+    //so anything drawn from then on sees the data
+    bool submitted(uint64_t ticket) const { return ticket < completedUploads; }
+    //number of uploads ever queued, the next ticket to be handed out
+    uint64_t queued() const { return queuedUploads; }
+    size_t totalBytesUploaded() const { return uploadedBytes; }
+
+  private:
+    struct Slot
+    {
+      unsigned int buffer = 0;
+      unsigned char *mapped = nullptr; //only set for persistent mappings
+      GLsync fence = 0;
+    };
+    struct Upload
+    {
+      unsigned int texture;
+      int level;
+      int width, height, channels;
+      const unsigned char *pixels;
+      std::shared_ptr<const void> owner;
+      bool generateMips;
+      GLenum compressedFormat; //0 for plain pixels
+      int layer; //-1 for GL_TEXTURE_2D
+      int nextRow; //in blocks for compressed levels
+    };
+
+    bool slotReady(Slot &slot, bool wait);
+    size_t pump(size_t byteBudget, bool wait);
+
+    std::vector<Slot> slots;
+    std::deque<Upload> pending;
+    size_t slotSize;
+    unsigned int nextSlot = 0;
+    bool persistent = false;
+    size_t uploadedBytes = 0;
+    uint64_t queuedUploads = 0;
+    uint64_t completedUploads = 0;
+};
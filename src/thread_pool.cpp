@@ -0,0 +1,53 @@
+#include "thread_pool.h"
+#include "cpu_profiler.h"
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+{
+  if (threadCount == 0)
+  {
+    threadCount = std::thread::hardware_concurrency();
+  }
+  if (threadCount == 0)
+  {
+    threadCount = 2;
+  }
+  workers.reserve(threadCount);
+  for (unsigned int i = 0; i < threadCount; i++)
+  {
+    workers.emplace_back(&ThreadPool::workerLoop, this);
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (std::thread &worker : workers)
+  {
+    worker.join();
+  }
+}
+
+void ThreadPool::workerLoop()
+{
+  setProfilerThreadName("pool worker");
+  while (true)
+  {
+    std::function<void()> job;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      wake.wait(lock, [this]() { return stopping || !jobs.empty(); });
+      //drain whatever is queued before shutting down so no future is left dangling
+      if (jobs.empty())
+      {
+        return;
+      }
+      job = std::move(jobs.front());
+      jobs.pop();
+    }
+    job();
+  }
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/*
+* A small fixed-size pool of worker threads.
+* Work is pushed as a callable and handed back as a std::future, so the
+* render thread can kick off a batch of jobs and only block on the ones it
+* actually needs right now.
+*/
+class ThreadPool
+{
+  public:
+    //0 threads means "one per hardware thread"
+    explicit ThreadPool(unsigned int threadCount = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    template <typename F>
+    auto submit(F&& job) -> std::future<decltype(job())>
+    {
+      using Result = decltype(job());
+      //std::function needs a copyable target, packaged_task is move only
+      auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(job));
+      std::future<Result> result = task->get_future();
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.emplace([task]() { (*task)(); });
+      }
+      wake.notify_one();
+      return result;
+    }
+
+    unsigned int size() const { return (unsigned int)workers.size(); }
+
+  private:
+    void workerLoop();
+
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+};
@@ -0,0 +1,508 @@
+/*
+* Cals_renderer_bench: renders generated scenes headless and reports how they scale.
+* Every scene runs a few warm-up frames and then a fixed number of measured
+* ones into an offscreen framebuffer (headless_context.h), and the results
+* go out as JSON so runs can be compared by a script.
+*
+* usage: Cals_renderer_bench [--frames <count>] [--scene <name>] [--output <file.json>]
+* Scenes:
+*   quads_1, quads_1k, quads_100k, quads_1m  textured quads in a grid, all instances
+*                                            rewritten and drawn with one instanced call per frame
+*   textures_1k                              64k quads over 1024 distinct textures, streamed
+*                                            through the quad batcher, one draw per texture
+*   textures_1k_budget                       the same 1024 files (a quarter of them copies of
+*                                            others) under a 28MB budget, 256 of them on screen
+*                                            at a time while the view pans across the rest
+* Texture scenes write their images to a temporary directory and load them through the
+* texture cache, as the renderer does.
+* Per scene: CPU frame time (recording and submitting, not waiting on the GPU) and GPU
+* frame time (timer queries) as percentiles in ms, draws and bytes uploaded per frame,
+* and for texture scenes what the cache did (deduplicated, demoted, evicted, reloaded) and
+* how streaming went: levels streamed, textures on screen still refining per frame and how
+* many frames (warm-up included) until none was.
+*/
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <unistd.h>
+#include "../config.h"
+#include "../gl_ext.h"
+#include "../gl_state.h"
+#include "../headless_context.h"
+#include "../gpu_profiler.h"
+#include "../cpu_profiler.h"
+#include "../instanced_mesh.h"
+#include "../quad_batcher.h"
+#include "../material_params.h"
+#include "../shader_permutations.h"
+#include "../texture_upload.h"
+#include "../texture_cache.h"
+
+static const char *usage = "usage: Cals_renderer_bench [--frames <count>] [--scene <name>] [--output <file.json>]";
+static const int WIDTH = 1280;
+static const int HEIGHT = 720;
+static const int WARMUP_FRAMES = 5;
+
+struct SceneResult
+{
+  std::string name;
+  size_t quads = 0;
+  size_t textures = 0;
+  std::vector<double> cpuMs;
+  GpuProfiler::PassStats gpu;
+  uint64_t draws = 0;
+  uint64_t uploadBytes = 0;
+  uint64_t setupUploadBytes = 0;
+  //texture scenes only
+  bool cached = false;
+  size_t budgetBytes = 0;
+  size_t peakResidentBytes = 0;
+  TextureCache::Stats cache;
+  //textures on screen still streaming finer mips, and the first frame with none (-1 if never)
+  uint64_t refining = 0;
+  int framesToFullDetail = -1;
+};
+
+//the unit square every scene draws copies of, in the shader.vs layout
+struct QuadMesh
+{
+  GLuint vertexArray = 0;
+  GLuint vertexBuffer = 0;
+  GLuint elementBuffer = 0;
+
+  QuadMesh()
+  {
+    float vertices[] = {
+       0.5f,  0.5f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f,
+       0.5f, -0.5f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f, 0.0f,
+      -0.5f, -0.5f, 0.0f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f,
+      -0.5f,  0.5f, 0.0f, 1.0f, 1.0f, 1.0f, 0.0f, 1.0f,
+    };
+    unsigned int indices[] = {0, 1, 3, 1, 2, 3};
+    glGenVertexArrays(1, &vertexArray);
+    glGenBuffers(1, &vertexBuffer);
+    glGenBuffers(1, &elementBuffer);
+    glState().bindVertexArray(vertexArray);
+    glState().bindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+  }
+  ~QuadMesh()
+  {
+    glState().deleteVertexArrays(1, &vertexArray);
+    glState().deleteBuffers(1, &vertexBuffer);
+    glState().deleteBuffers(1, &elementBuffer);
+  }
+};
+
+//a size x size texture array of `layers` layers, each a different flat color with a darker checker
+static GLuint makeTexture(TextureUploader &uploader, int size, int layers, uint32_t seed)
+{
+  GLuint texture = TextureUploader::createTextureArray(GL_RGBA8, size, size, layers, 1);
+  for (int layer = 0; layer < layers; layer++)
+  {
+    uint32_t color = (seed + layer) * 2654435761u;
+    std::shared_ptr<std::vector<unsigned char>> pixels(new std::vector<unsigned char>((size_t)size * size * 4));
+    for (int y = 0; y < size; y++)
+    {
+      for (int x = 0; x < size; x++)
+      {
+        unsigned char *pixel = pixels->data() + ((size_t)y * size + x) * 4;
+        int shade = ((x / 8 + y / 8) % 2) ? 255 : 160;
+        pixel[0] = (unsigned char)((color & 0xFF) * shade / 255);
+        pixel[1] = (unsigned char)(((color >> 8) & 0xFF) * shade / 255);
+        pixel[2] = (unsigned char)(((color >> 16) & 0xFF) * shade / 255);
+        pixel[3] = 255;
+      }
+    }
+    uploader.enqueue(texture, 0, size, size, 4, pixels->data(), pixels, false, layer);
+  }
+  return texture;
+}
+
+//runs warm-up and measured frames; frame() does one frame's work and returns (draws, upload bytes)
+template <typename Frame>
+static void measure(SceneResult &result, int frames, HeadlessContext &context, Frame frame)
+{
+  GpuProfiler gpu(4, frames);
+  for (int i = 0; i < WARMUP_FRAMES + frames; i++)
+  {
+    bool measured = i >= WARMUP_FRAMES;
+    uint64_t start = profilerNow();
+    if (measured)
+    {
+      gpu.beginFrame();
+      gpu.begin("frame");
+    }
+    glState().clearColor(0.2f, 0.3f, 0.3f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    std::pair<uint64_t, uint64_t> work = frame(i);
+    if (measured)
+    {
+      gpu.end();
+      gpu.endFrame();
+    }
+    context.present();
+    if (measured)
+    {
+      result.cpuMs.push_back((profilerNow() - start) / 1000000.0);
+      result.draws += work.first;
+      result.uploadBytes += work.second;
+    }
+  }
+  //let the last frames finish, then go around the ring once more to read them back
+  glFinish();
+  for (int i = 0; i < 4; i++)
+  {
+    gpu.beginFrame();
+    gpu.endFrame();
+  }
+  std::vector<GpuProfiler::PassStats> passes = gpu.report();
+  if (!passes.empty())
+  {
+    result.gpu = passes[0];
+  }
+}
+
+static SceneResult runQuads(const std::string &name, size_t quads, int frames, HeadlessContext &context)
+{
+  SceneResult result;
+  result.name = name;
+  result.quads = quads;
+  result.textures = 1;
+  QuadMesh mesh;
+  TextureUploader uploader;
+  GLuint texture = makeTexture(uploader, 64, 4, 1);
+  uploader.finish();
+  result.setupUploadBytes = uploader.totalBytesUploaded();
+  ShaderPermutations shaders("instanced.vs", "instanced.fs", {});
+  Shader &shader = shaders.get(0);
+  shader.use();
+  shader.setInt("materials", 0);
+  glState().bindTextureUnit(0, GL_TEXTURE_2D_ARRAY, texture);
+  InstancedMesh instances(mesh.vertexArray, 6, quads);
+  //a square grid over the whole target, so fill rate stays about the same at every count
+  size_t side = 1;
+  while (side * side < quads)
+  {
+    side++;
+  }
+  float cell = 2.0f / side;
+  measure(result, frames, context, [&](int frame)
+  {
+    instances.clear();
+    MeshInstance *out = instances.add(quads);
+    for (size_t i = 0; i < quads; i++)
+    {
+      MeshInstance &instance = out[i];
+      instance.position[0] = -1.0f + cell * (i % side + 0.5f);
+      instance.position[1] = -1.0f + cell * (i / side + 0.5f);
+      instance.position[2] = 0.0f;
+      instance.rotation = frame * 0.02f + i * 0.001f;
+      instance.scale[0] = instance.scale[1] = cell * 0.7f;
+      instance.layer = (int32_t)(i % 4);
+      instance.color[0] = instance.color[1] = instance.color[2] = instance.color[3] = 255;
+    }
+    instances.upload();
+    shader.use();
+    instances.draw();
+    return std::make_pair((uint64_t)1, (uint64_t)instances.uploadedBytes());
+  });
+  glState().deleteTextures(1, &texture);
+  return result;
+}
+
+//a size x size binary PPM in a flat color with a darker checker, like makeTexture's layers
+static bool writeTextureFile(const std::string &path, int size, uint32_t seed)
+{
+  FILE *file = fopen(path.c_str(), "wb");
+  if (!file)
+  {
+    return false;
+  }
+  uint32_t color = seed * 2654435761u;
+  fprintf(file, "P6\n%d %d\n255\n", size, size);
+  std::vector<unsigned char> row((size_t)size * 3);
+  for (int y = 0; y < size; y++)
+  {
+    for (int x = 0; x < size; x++)
+    {
+      int shade = ((x / 8 + y / 8) % 2) ? 255 : 160;
+      row[x * 3 + 0] = (unsigned char)((color & 0xFF) * shade / 255);
+      row[x * 3 + 1] = (unsigned char)(((color >> 8) & 0xFF) * shade / 255);
+      row[x * 3 + 2] = (unsigned char)(((color >> 16) & 0xFF) * shade / 255);
+    }
+    fwrite(row.data(), 1, row.size(), file);
+  }
+  return fclose(file) == 0;
+}
+
+//textureCount files (distinct different contents, the rest repeat them) loaded through a TextureCache;
+//each frame draws quadsPerTexture quads for `visible` of them, panning across the set
+static SceneResult runTextures(const std::string &name, size_t textureCount, size_t distinct, size_t visible,
+                               size_t quadsPerTexture, size_t budgetBytes, int frames, HeadlessContext &context)
+{
+  SceneResult result;
+  result.name = name;
+  result.quads = visible * quadsPerTexture;
+  result.textures = textureCount;
+  result.cached = true;
+  result.budgetBytes = budgetBytes;
+  char directory[] = "/tmp/cals_bench_XXXXXX";
+  if (!mkdtemp(directory))
+  {
+    std::cout << "Cannot create a temporary directory for " << name << std::endl;
+    return result;
+  }
+  std::vector<std::string> paths;
+  for (size_t i = 0; i < textureCount; i++)
+  {
+    paths.push_back(std::string(directory) + "/texture" + std::to_string(i) + ".ppm");
+    writeTextureFile(paths.back(), 128, (uint32_t)(i % distinct));
+  }
+
+  TextureDecodePool decodePool;
+  TextureUploader uploader;
+  {
+    //no budget while loading: everything gets its small mips first, then the scene's budget applies
+    //finer levels only stream once a texture is drawn, so that part is measured
+    TextureCache cache(decodePool, uploader, (size_t)-1);
+    std::vector<TextureHandle> handles;
+    for (const std::string &path : paths)
+    {
+      handles.push_back(cache.load("", path));
+    }
+    while (cache.loadingCount())
+    {
+      uploader.update();
+      cache.update();
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    uploader.finish();
+    result.setupUploadBytes = uploader.totalBytesUploaded();
+    cache.setBudget(budgetBytes);
+
+    ShaderPermutations shaders("shader.vs", "shader.fs", {"OVERLAY", "VERTEX_COLOR", "SINGLE_TEXTURE"});
+    Shader &shader = shaders.get(MATERIAL_VERTEX_COLOR | MATERIAL_SINGLE_TEXTURE);
+    shader.use();
+    shader.setInt("materials", 0);
+    shader.bindBlock("MaterialParams", MATERIAL_PARAMS_BINDING, sizeof(MaterialParams));
+    UniformBlockBuffer<MaterialParams> material(1);
+    material.push({0, 0, 0.0f, 0.0f, {1.0f, 1.0f, 1.0f, 1.0f}});
+    material.upload();
+    material.bind(MATERIAL_PARAMS_BINDING, 0);
+    QuadBatcher batcher(result.quads);
+    size_t side = 1;
+    while (side * side < result.quads)
+    {
+      side++;
+    }
+    float cell = 2.0f / side;
+    measure(result, frames, context, [&](int frame)
+    {
+      QuadBatcher::Stats before = batcher.stats();
+      size_t uploadedBefore = uploader.totalBytesUploaded();
+      uploader.update(8 * 1024 * 1024);
+      cache.update();
+      result.peakResidentBytes = std::max(result.peakResidentBytes, cache.residentBytes());
+      shader.use();
+      batcher.begin();
+      size_t first = visible < textureCount ? (size_t)frame * 16 % textureCount : 0;
+      size_t quad = 0;
+      for (size_t t = 0; t < visible; t++)
+      {
+        //a new texture means a new draw, everything drawn with the last one goes out first
+        batcher.flush();
+        GLuint texture = cache.acquire(handles[(first + t) % textureCount]);
+        glState().bindTextureUnit(0, GL_TEXTURE_2D, texture);
+        for (size_t i = 0; i < quadsPerTexture; i++, quad++)
+        {
+          float x = -1.0f + cell * (quad % side);
+          float y = -1.0f + cell * (quad / side);
+          float wobble = cell * 0.1f * (float)sin(frame * 0.1 + quad);
+          batcher.quad(x + wobble, y, x + wobble + cell * 0.8f, y + cell * 0.8f, 0.0f, 1.0f, 1.0f, 1.0f);
+        }
+      }
+      batcher.end();
+      size_t refining = cache.refiningCount();
+      if (frame >= WARMUP_FRAMES)
+      {
+        result.refining += refining;
+      }
+      if (!refining && result.framesToFullDetail < 0)
+      {
+        result.framesToFullDetail = frame + 1;
+      }
+      uint64_t uploaded = batcher.stats().bytes - before.bytes + uploader.totalBytesUploaded() - uploadedBefore;
+      return std::make_pair(batcher.stats().draws - before.draws, uploaded);
+    });
+    result.cache = cache.stats();
+  }
+
+  for (const std::string &path : paths)
+  {
+    unlink(path.c_str());
+  }
+  rmdir(directory);
+  return result;
+}
+
+static double percentile(std::vector<double> sorted, double fraction)
+{
+  if (sorted.empty())
+  {
+    return 0.0;
+  }
+  std::sort(sorted.begin(), sorted.end());
+  return sorted[std::min(sorted.size() - 1, (size_t)(sorted.size() * fraction))];
+}
+
+static void writeJson(FILE *file, const std::vector<SceneResult> &results, int frames)
+{
+  const char *renderer = (const char*)glGetString(GL_RENDERER);
+  fprintf(file, "{\n  \"renderer\": \"%s\",\n  \"width\": %d,\n  \"height\": %d,\n  \"frames\": %d,\n  \"scenes\": [\n",
+          renderer ? renderer : "unknown", WIDTH, HEIGHT, frames);
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    const SceneResult &result = results[i];
+    const std::vector<double> &cpu = result.cpuMs;
+    double cpuTotal = 0.0;
+    for (double ms : cpu)
+    {
+      cpuTotal += ms;
+    }
+    double measured = cpu.empty() ? 1.0 : (double)cpu.size();
+    fprintf(file, "    {\n      \"name\": \"%s\",\n      \"quads\": %zu,\n      \"textures\": %zu,\n",
+            result.name.c_str(), result.quads, result.textures);
+    fprintf(file, "      \"draws_per_frame\": %.1f,\n      \"upload_bytes_per_frame\": %.0f,\n      \"setup_upload_bytes\": %llu,\n",
+            result.draws / measured, result.uploadBytes / measured, (unsigned long long)result.setupUploadBytes);
+    fprintf(file, "      \"cpu_ms\": {\"min\": %.4f, \"avg\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"max\": %.4f},\n",
+            percentile(cpu, 0.0), cpuTotal / measured, percentile(cpu, 0.5), percentile(cpu, 0.9), percentile(cpu, 0.99), percentile(cpu, 1.0));
+    fprintf(file, "      \"gpu_ms\": {\"min\": %.4f, \"avg\": %.4f, \"p50\": %.4f, \"p99\": %.4f, \"samples\": %zu}%s\n",
+            result.gpu.minMs, result.gpu.avgMs, result.gpu.p50Ms, result.gpu.p99Ms, result.gpu.samples, result.cached ? "," : "");
+    if (result.cached)
+    {
+      const TextureCache::Stats &cache = result.cache;
+      fprintf(file, "      \"texture_cache\": {\"budget_bytes\": %zu, \"peak_resident_bytes\": %zu, \"deduplicated\": %llu, "
+                    "\"demoted\": %llu, \"evicted\": %llu, \"reloaded\": %llu,\n",
+              result.budgetBytes, result.peakResidentBytes, (unsigned long long)cache.deduplicated,
+              (unsigned long long)cache.demoted, (unsigned long long)cache.evicted, (unsigned long long)cache.reloaded);
+      fprintf(file, "        \"streamed_levels\": %llu, \"refining_per_frame\": %.1f, \"frames_to_full_detail\": %d}\n",
+              (unsigned long long)cache.streamedLevels, result.refining / measured, result.framesToFullDetail);
+    }
+    fprintf(file, "    }%s\n", i + 1 < results.size() ? "," : "");
+  }
+  fputs("  ]\n}\n", file);
+}
+
+int main(int argc, char **argv)
+{
+  int frames = 100;
+  std::string onlyScene;
+  std::string outputPath;
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+    {
+      frames = atoi(argv[++i]);
+      if (frames <= 0)
+      {
+        std::cout << usage << std::endl;
+        return 1;
+      }
+    }
+    else if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc)
+    {
+      onlyScene = argv[++i];
+    }
+    else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+    {
+      outputPath = argv[++i];
+    }
+    else
+    {
+      std::cout << usage << std::endl;
+      return 1;
+    }
+  }
+
+  HeadlessContext context(WIDTH, HEIGHT);
+  if (!context.ok() || !gladLoadGLLoader((GLADloadproc)HeadlessContext::getProcAddress))
+  {
+    std::cout << "Failed to create a headless GL context" << std::endl;
+    return 1;
+  }
+  loadGLExtensions((GLADloadproc)HeadlessContext::getProcAddress);
+  if (!context.createFramebuffer())
+  {
+    return 1;
+  }
+
+  //texture scenes: quads per texture, texture files, distinct contents, textures on screen, budget
+  struct Scene
+  {
+    const char *name;
+    size_t quads;
+    size_t textures;
+    size_t distinct;
+    size_t visible;
+    size_t budgetBytes;
+  };
+  const Scene scenes[] = {
+    {"quads_1", 1, 0, 0, 0, 0},
+    {"quads_1k", 1000, 0, 0, 0, 0},
+    {"quads_100k", 100000, 0, 0, 0, 0},
+    {"quads_1m", 1000000, 0, 0, 0, 0},
+    {"textures_1k", 64, 1024, 1024, 1024, 256 * 1024 * 1024},
+    {"textures_1k_budget", 64, 1024, 768, 256, 28 * 1024 * 1024},
+  };
+  std::vector<SceneResult> results;
+  for (const Scene &scene : scenes)
+  {
+    if (!onlyScene.empty() && onlyScene != scene.name)
+    {
+      continue;
+    }
+    //progress goes to stderr, stdout is left for the report
+    fprintf(stderr, "%s...\n", scene.name);
+    if (scene.textures)
+    {
+      results.push_back(runTextures(scene.name, scene.textures, scene.distinct, scene.visible, scene.quads,
+                                    scene.budgetBytes, frames, context));
+    }
+    else
+    {
+      results.push_back(runQuads(scene.name, scene.quads, frames, context));
+    }
+  }
+  if (results.empty())
+  {
+    std::cout << "Unknown scene " << onlyScene << std::endl;
+    return 1;
+  }
+
+  FILE *file = outputPath.empty() ? stdout : fopen(outputPath.c_str(), "w");
+  if (!file)
+  {
+    std::cout << "Cannot write " << outputPath << std::endl;
+    return 1;
+  }
+  writeJson(file, results, frames);
+  if (file != stdout)
+  {
+    fclose(file);
+  }
+  return 0;
+}
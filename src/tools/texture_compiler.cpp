@@ -0,0 +1,191 @@
+/*
+* Cals_texc: bakes an image into a .ctex container (see texture_container.h).
+* Runs at build time so the renderer never decodes, flips or builds mips.
+*
+* usage: Cals_texc [--no-flip] [--format none|bc1|bc3|bc7] [--quality fast|normal|high]
+*                  [--resize <width> <height>] <input image> <output.ctex>
+* With a block format every mip level is encoded on all cores.
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../mipmap.h"
+#include "../texture_container.h"
+#include "../texture_formats.h"
+#include "../thread_pool.h"
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+static bool parseFormat(const char *name, BlockFormat &format)
+{
+  if (strcmp(name, "none") == 0) format = BlockFormat::None;
+  else if (strcmp(name, "bc1") == 0) format = BlockFormat::BC1;
+  else if (strcmp(name, "bc3") == 0) format = BlockFormat::BC3;
+  else if (strcmp(name, "bc7") == 0) format = BlockFormat::BC7;
+  else return false;
+  return true;
+}
+
+static bool parseQuality(const char *name, EncodeQuality &quality)
+{
+  if (strcmp(name, "fast") == 0) quality = EncodeQuality::Fast;
+  else if (strcmp(name, "normal") == 0) quality = EncodeQuality::Normal;
+  else if (strcmp(name, "high") == 0) quality = EncodeQuality::High;
+  else return false;
+  return true;
+}
+
+static const char *usage = "usage: Cals_texc [--no-flip] [--format none|bc1|bc3|bc7] [--quality fast|normal|high] "
+                           "[--resize <width> <height>] <input image> <output.ctex>";
+
+static uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+int main(int argc, char **argv)
+{
+  bool flip = true;
+  TextureCompression compression;
+  int resizeWidth = 0, resizeHeight = 0;
+  std::vector<std::string> paths;
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--no-flip") == 0)
+    {
+      flip = false;
+    }
+    else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc)
+    {
+      if (!parseFormat(argv[++i], compression.format))
+      {
+        std::cout << usage << std::endl;
+        return 1;
+      }
+    }
+    else if (strcmp(argv[i], "--resize") == 0 && i + 2 < argc)
+    {
+      resizeWidth = atoi(argv[++i]);
+      resizeHeight = atoi(argv[++i]);
+      if (resizeWidth <= 0 || resizeHeight <= 0)
+      {
+        std::cout << usage << std::endl;
+        return 1;
+      }
+    }
+    else if (strcmp(argv[i], "--quality") == 0 && i + 1 < argc)
+    {
+      if (!parseQuality(argv[++i], compression.quality))
+      {
+        std::cout << usage << std::endl;
+        return 1;
+      }
+    }
+    else
+    {
+      paths.push_back(argv[i]);
+    }
+  }
+  if (paths.size() != 2)
+  {
+    std::cout << usage << std::endl;
+    return 1;
+  }
+
+  //same orientation the renderer used to get from stbi_set_flip_vertically_on_load
+  stbi_set_flip_vertically_on_load(flip);
+  int width, height, channels;
+  unsigned char *pixels = stbi_load(paths[0].c_str(), &width, &height, &channels, 0);
+  if (!pixels)
+  {
+    std::cout << "ERROR::TEXC::LOAD_FAILED " << paths[0] << ": " << stbi_failure_reason() << std::endl;
+    return 1;
+  }
+
+  //resizing is for textures that have to share a texture array with others
+  const unsigned char *base = pixels;
+  MipLevel resized;
+  if (resizeWidth && (resizeWidth != width || resizeHeight != height))
+  {
+    resized = resizeImage(pixels, width, height, channels, resizeWidth, resizeHeight);
+    base = resized.pixels.data();
+    width = resizeWidth;
+    height = resizeHeight;
+  }
+
+  std::vector<MipLevel> chain = buildMipChain(base, width, height, channels);
+  uint32_t levelCount = (uint32_t)chain.size() + 1;
+  bool compressed = compression.format != BlockFormat::None;
+  //encoded levels replace the raw ones, the base level included
+  std::vector<std::vector<unsigned char>> encoded;
+  if (compressed)
+  {
+    ThreadPool pool;
+    encoded.push_back(encodeBlocks(base, width, height, channels, compression, &pool));
+    for (const MipLevel &level : chain)
+    {
+      encoded.push_back(encodeBlocks(level.pixels.data(), level.width, level.height, channels, compression, &pool));
+    }
+  }
+
+  TextureContainerHeader header = {};
+  header.magic = TEXTURE_CONTAINER_MAGIC;
+  header.version = TEXTURE_CONTAINER_VERSION;
+  header.width = width;
+  header.height = height;
+  header.levelCount = levelCount;
+  header.channels = channels;
+  header.internalFormat = compressed ? internalFormatForBlockFormat(compression.format) : internalFormatForChannels(channels);
+  header.compressed = compressed ? 1 : 0;
+
+  std::vector<TextureContainerLevel> levels(levelCount);
+  std::vector<const unsigned char*> levelPixels(levelCount);
+  uint64_t offset = alignUp(sizeof(header) + levelCount * sizeof(TextureContainerLevel), 16);
+  for (uint32_t i = 0; i < levelCount; i++)
+  {
+    levels[i].width = i == 0 ? width : chain[i - 1].width;
+    levels[i].height = i == 0 ? height : chain[i - 1].height;
+    levels[i].offset = offset;
+    if (compressed)
+    {
+      levels[i].size = encoded[i].size();
+      levelPixels[i] = encoded[i].data();
+    }
+    else
+    {
+      levels[i].size = (uint64_t)levels[i].width * levels[i].height * channels;
+      levelPixels[i] = i == 0 ? base : chain[i - 1].pixels.data();
+    }
+    offset = alignUp(offset + levels[i].size, 16);
+  }
+
+  FILE *out = fopen(paths[1].c_str(), "wb");
+  if (!out)
+  {
+    std::cout << "ERROR::TEXC::OPEN_FAILED " << paths[1] << std::endl;
+    stbi_image_free(pixels);
+    return 1;
+  }
+  fwrite(&header, sizeof(header), 1, out);
+  fwrite(levels.data(), sizeof(TextureContainerLevel), levelCount, out);
+  static const unsigned char padding[16] = {};
+  for (uint32_t i = 0; i < levelCount; i++)
+  {
+    long position = ftell(out);
+    fwrite(padding, 1, levels[i].offset - position, out);
+    fwrite(levelPixels[i], 1, levels[i].size, out);
+  }
+  bool ok = ferror(out) == 0;
+  ok = fclose(out) == 0 && ok;
+  stbi_image_free(pixels);
+  if (!ok)
+  {
+    std::cout << "ERROR::TEXC::WRITE_FAILED " << paths[1] << std::endl;
+    remove(paths[1].c_str());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,47 @@
+#include "uniform_buffer.h"
+#include "gl_state.h"
+#include <cstring>
+
+UniformBufferStream::UniformBufferStream(size_t blockSize, size_t capacity)
+  : blockSize(blockSize), capacity(capacity)
+{
+  GLint alignment = 256;
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+  blockStride = (blockSize + alignment - 1) / alignment * alignment;
+  staging.resize(blockStride * capacity);
+  glGenBuffers(1, &buffer);
+}
+
+UniformBufferStream::~UniformBufferStream()
+{
+  glState().deleteBuffers(1, &buffer);
+}
+
+uint32_t UniformBufferStream::push(const void *block)
+{
+  if (count == capacity)
+  {
+    capacity *= 2;
+    staging.resize(blockStride * capacity);
+  }
+  memcpy(staging.data() + count * blockStride, block, blockSize);
+  return count++;
+}
+
+void UniformBufferStream::upload()
+{
+  if (!count)
+  {
+    return;
+  }
+  glState().bindBuffer(GL_UNIFORM_BUFFER, buffer);
+  //orphan first: the driver hands back new storage if the GPU still reads the old one
+  size_t bytes = blockStride * capacity;
+  glBufferData(GL_UNIFORM_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, blockStride * count, staging.data());
+}
+
+void UniformBufferStream::bind(GLuint binding, uint32_t index) const
+{
+  glState().bindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, index * blockStride, blockSize);
+}
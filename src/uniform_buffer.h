@@ -0,0 +1,123 @@
+#pragma once
+#include "config.h"
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+/*
+* C++ mirrors of std140 types. Each has the C++ alignment std140 gives it,
+* so a struct built from them (and plain float / int32_t / uint32_t) is laid
+* out exactly like the matching layout(std140) uniform block.
+* One catch: std140 packs a scalar into the unused last component of a
+* vec3, a C++ struct cannot, so never follow a vec3 with a scalar (use vec4).
+* Shader::bindBlock compares sizes with the driver and catches that case.
+*/
+namespace std140
+{
+  struct alignas(8) vec2 { float x, y; };
+  struct alignas(16) vec3 { float x, y, z; };
+  struct alignas(16) vec4 { float x, y, z, w; };
+  struct alignas(16) ivec4 { int32_t x, y, z, w; };
+  //column major like GLSL, every column a vec4
+  struct alignas(16) mat4 { float m[16]; };
+  //array elements are padded to 16 bytes in std140, scalars included
+  template <typename T, size_t N>
+  struct alignas(16) array
+  {
+    struct alignas(16) Element { T value; };
+    Element elements[N];
+    T &operator[](size_t i) { return elements[i].value; }
+    const T &operator[](size_t i) const { return elements[i].value; }
+  };
+
+  //base alignment of every type allowed in a block, anything else does not compile
+  template <typename T> struct alignment;
+  template <> struct alignment<float> { static constexpr size_t value = 4; };
+  template <> struct alignment<int32_t> { static constexpr size_t value = 4; };
+  template <> struct alignment<uint32_t> { static constexpr size_t value = 4; };
+  template <> struct alignment<vec2> { static constexpr size_t value = 8; };
+  template <> struct alignment<vec3> { static constexpr size_t value = 16; };
+  template <> struct alignment<vec4> { static constexpr size_t value = 16; };
+  template <> struct alignment<ivec4> { static constexpr size_t value = 16; };
+  template <> struct alignment<mat4> { static constexpr size_t value = 16; };
+  template <typename T, size_t N> struct alignment<array<T, N>> { static constexpr size_t value = 16; };
+
+  //what every block struct must be: copyable as bytes, and padded to a vec4 like std140 pads it
+  template <typename T>
+  constexpr bool isBlock()
+  {
+    return std::is_standard_layout<T>::value && std::is_trivially_copyable<T>::value && sizeof(T) % 16 == 0;
+  }
+}
+
+//list every member of a block struct with this after its definition: an unsupported type
+//(e.g. float[4], which std140 strides by 16) or a misaligned offset fails to compile
+#define STD140_MEMBER(Block, member) \
+  static_assert(offsetof(Block, member) % std140::alignment<std::remove_cv<decltype(Block::member)>::type>::value == 0, \
+                #Block "::" #member " is not std140 aligned")
+
+//buffer and byte range of one block, for binds recorded now and issued later (RenderQueue)
+struct UniformRange
+{
+  GLuint buffer = 0;
+  GLintptr offset = 0;
+  GLsizeiptr size = 0;
+};
+
+/*
+* Blocks for a frame's draws, all in one uniform buffer.
+* Blocks are appended on the CPU as draws are recorded, upload() writes
+* them all with a single glBufferSubData into freshly orphaned storage
+* (so it never waits on the GPU still reading last frame's), and each draw
+* binds its own block with glBindBufferRange. Blocks sit at multiples of
+* GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, as glBindBufferRange requires.
+* Use the typed UniformBlockBuffer<T> below.
+*/
+class UniformBufferStream
+{
+  public:
+    UniformBufferStream(size_t blockSize, size_t capacity);
+    ~UniformBufferStream();
+    UniformBufferStream(const UniformBufferStream&) = delete;
+    UniformBufferStream& operator=(const UniformBufferStream&) = delete;
+
+    //copies a block in, returns its index for bind(); grows the buffer when full
+    uint32_t push(const void *block);
+    //the one buffer write of the frame
+    void upload();
+    //binds block index to a binding point (see Shader::bindBlock)
+    void bind(GLuint binding, uint32_t index) const;
+    UniformRange range(uint32_t index) const { return {buffer, (GLintptr)(index * blockStride), (GLsizeiptr)blockSize}; }
+    //starts the next frame, indices from before are invalid
+    void clear() { count = 0; }
+
+    uint32_t size() const { return count; }
+    size_t stride() const { return blockStride; }
+
+  private:
+    GLuint buffer = 0;
+    size_t blockSize;
+    size_t blockStride;
+    size_t capacity;
+    uint32_t count = 0;
+    std::vector<unsigned char> staging;
+};
+
+template <typename T>
+class UniformBlockBuffer
+{
+  static_assert(std140::isBlock<T>(), "uniform blocks must be trivially copyable, standard layout and a multiple of 16 bytes");
+
+  public:
+    explicit UniformBlockBuffer(size_t capacity = 64) : stream(sizeof(T), capacity) {}
+
+    uint32_t push(const T &block) { return stream.push(&block); }
+    void upload() { stream.upload(); }
+    void bind(GLuint binding, uint32_t index) const { stream.bind(binding, index); }
+    UniformRange range(uint32_t index) const { return stream.range(index); }
+    void clear() { stream.clear(); }
+    uint32_t size() const { return stream.size(); }
+
+  private:
+    UniformBufferStream stream;
+};